@@ -1,5 +1,7 @@
 #include "devil_cpp_wrapper.h"
 
+#include "../memory_stats.h"
+
 //
 // ILIMAGE
 //
@@ -68,9 +70,21 @@ ILboolean ilImage::Save(ILconst_string FileName, ILenum Type)
 	return ilSave(Type, FileName);
 }
 
+// DevIL allocates through the tracked allocator, so its image data shows up in the memory stats per stage.
+static void* ILAPIENTRY devil_tracked_alloc(const ILsizei Size)
+{
+	return tracked_alloc((size_t)Size);
+}
+
+static void ILAPIENTRY devil_tracked_free(const void* Pointer)
+{
+	tracked_free(Pointer);
+}
+
 // ensure that init is called exactly once
 int ilImage::ilStartUp()
 {
+	ilSetMemory(devil_tracked_alloc, devil_tracked_free); // Before ilInit allocates anything.
 	ilInit();
 	iluInit();
 	//ilutInit();
@@ -7,6 +7,8 @@
 */
 #include "RectangleBinPack.h"
 
+#include <algorithm>
+
 namespace rbp {
 
 /** Restarts the packing process, clearing all previously packed rectangles and
@@ -79,6 +81,13 @@ std::shared_ptr<RectangleBinPack::Node> RectangleBinPack::Insert(std::shared_ptr
 	if (width > node->width || height > node->height)
 		return 0; // Too bad, no space.
 
+	Split(node, width, height);
+	return node;
+}
+
+/** Turns a leaf into an internal node occupying its top left width x height. */
+void RectangleBinPack::Split(const std::shared_ptr<RectangleBinPack::Node> &node, int width, int height)
+{
 	// The new cell will fit, split the remaining space along the shorter axis,
 	// that is probably more optimal.
 	int w = node->width - width;
@@ -119,7 +128,93 @@ std::shared_ptr<RectangleBinPack::Node> RectangleBinPack::Insert(std::shared_ptr
 	// area of free space.
 	node->width = width;
 	node->height = height;
-	return node;
+}
+
+/** Recursively calls itself. Leaves only partly covered by the area are split up until
+	the covered part sits in a top left corner, so Split can take it from there. */
+unsigned long RectangleBinPack::Reserve(const std::shared_ptr<RectangleBinPack::Node> &node, int x, int y, int width, int height)
+{
+	if (node->left || node->right)
+	{
+		unsigned long reservedSurfaceArea = 0;
+		if (node->left)
+			reservedSurfaceArea += Reserve(node->left, x, y, width, height);
+		if (node->right)
+			reservedSurfaceArea += Reserve(node->right, x, y, width, height);
+		return reservedSurfaceArea;
+	}
+
+	// Clip the area to this leaf.
+	const int left   = std::max(x, node->x);
+	const int top    = std::max(y, node->y);
+	const int right  = std::min(x + width, node->x + node->width);
+	const int bottom = std::min(y + height, node->y + node->height);
+	if (left >= right || top >= bottom)
+		return 0; // Nothing to do here.
+
+	if (top > node->y || left > node->x)
+	{
+		// Cut off the free strip above or to the left of the area. This node keeps no used space of its own.
+		const Node leaf = *node;
+		node->left  = std::make_shared<Node>(leaf);
+		node->right = std::make_shared<Node>(leaf);
+		if (top > node->y)
+		{
+			node->left->height = top - node->y;
+			node->right->y = top;
+			node->right->height = node->height - node->left->height;
+		}
+		else
+		{
+			node->left->width = left - node->x;
+			node->right->x = left;
+			node->right->width = node->width - node->left->width;
+		}
+		node->width = node->height = 0;
+		return Reserve(node->right, x, y, width, height);
+	}
+
+	Split(node, right - left, bottom - top);
+	return (unsigned long)(right - left) * (bottom - top);
+}
+
+/** Running time is linear to the number of rectangles already packed. */
+bool RectangleBinPack::Reserve(int x, int y, int width, int height)
+{
+	if (x < 0 || y < 0 || x + width > binWidth || y + height > binHeight)
+		return false;
+	return Reserve(root, x, y, width, height) == (unsigned long)width * height;
+}
+
+/** Recursively calls itself. */
+void RectangleBinPack::FreeSurfaceArea(const std::shared_ptr<Node> &node, unsigned long &total, unsigned long &largest) const
+{
+	if (node->left || node->right)
+	{
+		if (node->left)
+			FreeSurfaceArea(node->left, total, largest);
+		if (node->right)
+			FreeSurfaceArea(node->right, total, largest);
+		return;
+	}
+
+	// This is a leaf node, all of it is free.
+	const unsigned long freeSurfaceArea = (unsigned long)node->width * node->height;
+	total += freeSurfaceArea;
+	largest = std::max(largest, freeSurfaceArea);
+}
+
+/** @return A value [0, 1]: one minus the share of free surface area taken by the largest free rectangle.
+	0.0f for a bin that is full or has all free area in one piece. */
+float RectangleBinPack::Fragmentation() const
+{
+	unsigned long totalFreeSurfaceArea = 0;
+	unsigned long largestFreeSurfaceArea = 0;
+	FreeSurfaceArea(root, totalFreeSurfaceArea, largestFreeSurfaceArea);
+	if (totalFreeSurfaceArea == 0)
+		return 0.0f;
+
+	return 1.0f - (float)largestFreeSurfaceArea/totalFreeSurfaceArea;
 }
 
 }
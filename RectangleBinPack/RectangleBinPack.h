@@ -70,9 +70,19 @@ public:
 		return Insert(root, width, height);
 	}
 
+	/// Marks the given area of the bin as used, without looking for a spot.
+	/** Meant for seeding the bin with rectangles packed earlier, so that they keep their place.
+		@return False if part of the area was already in use or lies outside the bin. */
+	bool Reserve(int x, int y, int width, int height);
+
 	/// Computes the ratio of used surface area.
 	float Occupancy() const;
 
+	/// Computes how scattered the free surface area is.
+	/** @return 0 if all free area is a single rectangle, approaching 1 as it is spread over
+		ever more and smaller rectangles. */
+	float Fragmentation() const;
+
 private:
 	std::shared_ptr<Node> root;
 
@@ -85,6 +95,16 @@ private:
 
 	/// Inserts a new rectangle in the subtree rooted at the given node.
 	std::shared_ptr<Node> Insert(std::shared_ptr<Node> node, int width, int height);
+
+	/// Marks the top left corner of the given size of a leaf as used, splitting the rest into two free leaves.
+	static void Split(const std::shared_ptr<Node> &node, int width, int height);
+
+	/// Marks the given area as used in the subtree rooted at the given node.
+	/** @return The surface area that was still free. */
+	unsigned long Reserve(const std::shared_ptr<Node> &node, int x, int y, int width, int height);
+
+	/// Adds up free surface area in the subtree rooted at node, and finds its largest free rectangle.
+	void FreeSurfaceArea(const std::shared_ptr<Node> &node, unsigned long &total, unsigned long &largest) const;
 };
 
 }
@@ -0,0 +1,51 @@
+#include "atlas_regions.h"
+
+#include <algorithm>
+#include <cmath>
+
+unsigned int mipmap_texels_wide_scaled(const unsigned int &tile_mipID, const unsigned int &tile_texels_wide, const unsigned int &tile_border_texels_wide)
+{
+	const unsigned int mipmap_tiles_wide  = 1u << tile_mipID;
+	const unsigned int mipmap_texels_wide = mipmap_tiles_wide * tile_texels_wide;
+	return mipmap_texels_wide - mipmap_tiles_wide * 2 * tile_border_texels_wide;
+}
+
+// Range [first, last] of tiles along one axis, in mipmap texel order, whose texels overlap [begin, end) of the mipmap.
+static bool tile_range(const long long &begin, const long long &end, const long long &tiles_wide, const long long &tile_texels_wide, const long long &tile_border_texels_wide, long long &first, long long &last)
+{
+	// Tile i covers mipmap texels [i * payload - border, i * payload - border + tile_texels_wide).
+	const long long payload_texels_wide = tile_texels_wide - 2 * tile_border_texels_wide;
+	first = (long long)std::floor((double)(begin + tile_border_texels_wide - tile_texels_wide) / payload_texels_wide) + 1;
+	last  = (long long)std::ceil ((double)(end   + tile_border_texels_wide)                    / payload_texels_wide) - 1;
+	first = std::max(first, 0LL);
+	last  = std::min(last, tiles_wide - 1);
+	return first <= last;
+}
+
+std::set<tile_coordinate> tiles_overlapping(const atlas_rectangle &mipmap_region, const unsigned int &tile_mipID,
+	const unsigned int &tile_texels_wide, const unsigned int &tile_border_texels_wide)
+{
+	std::set<tile_coordinate> tiles;
+	if (mipmap_region.width == 0 || mipmap_region.height == 0)
+	{
+		return tiles;
+	}
+
+	const long long mipmap_tiles_wide = 1LL << tile_mipID;
+	long long first_column, last_column, first_row, last_row;
+	if (!tile_range(mipmap_region.x, (long long)mipmap_region.x + mipmap_region.width,  mipmap_tiles_wide, tile_texels_wide, tile_border_texels_wide, first_column, last_column) ||
+		!tile_range(mipmap_region.y, (long long)mipmap_region.y + mipmap_region.height, mipmap_tiles_wide, tile_texels_wide, tile_border_texels_wide, first_row,    last_row))
+	{
+		return tiles;
+	}
+
+	for (long long row = first_row; row <= last_row; row++)
+	{
+		for (long long column = first_column; column <= last_column; column++)
+		{
+			// Rows count down from the top of the image, tile y counts up from the bottom.
+			tiles.insert({ (unsigned int)column, (unsigned int)(mipmap_tiles_wide - 1 - row) });
+		}
+	}
+	return tiles;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ATLAS_REGIONS_H
+#define ATLAS_REGIONS_H
+
+#include <set>
+
+// Geometry shared by the mipmap and tile steps: which mipmap texels and which tiles a region of the atlas ends up in.
+
+// A rectangle in texels of the atlas or one of its mipmap levels, upper left origin like all image manipulation in this program.
+struct atlas_rectangle
+{
+	unsigned int x = 0;
+	unsigned int y = 0;
+	unsigned int width = 0;
+	unsigned int height = 0;
+};
+
+// Tile coordinates as used in tile file names: lower left origin.
+struct tile_coordinate
+{
+	unsigned int x;
+	unsigned int y;
+};
+
+inline bool operator<(const tile_coordinate &a, const tile_coordinate &b)
+{
+	return a.y < b.y || (a.y == b.y && a.x < b.x);
+}
+
+// Width (and height) in texels of the atlas mipmap level for the given tile mipID, scaled down to make room for tile borders.
+unsigned int mipmap_texels_wide_scaled(const unsigned int &tile_mipID, const unsigned int &tile_texels_wide, const unsigned int &tile_border_texels_wide);
+
+// All tiles of the given tile mipID that contain, border included, texels of the given region of that mipmap level.
+std::set<tile_coordinate> tiles_overlapping(const atlas_rectangle &mipmap_region, const unsigned int &tile_mipID,
+	const unsigned int &tile_texels_wide, const unsigned int &tile_border_texels_wide);
+
+#endif // ATLAS_REGIONS_H
@@ -0,0 +1,208 @@
+#include "atlas_report.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include "helper_functions.h" // json_quote, mipIDForDimensions
+#include "mipmap_resample.h"  // mipmap_region_for
+
+atlas_report::atlas_report(const unsigned int &atlas_texels_wide, const unsigned int &tile_texels_wide, const unsigned int &tile_border_texels_wide, const unsigned int &bytes_per_texel) :
+	m_atlas_texels_wide(atlas_texels_wide),
+	m_tile_texels_wide(tile_texels_wide),
+	m_tile_border_texels_wide(tile_border_texels_wide),
+	m_bytes_per_texel(bytes_per_texel),
+	m_occupancy(0.0f),
+	m_used_texels(0)
+{
+	const unsigned int max_mipID = mipIDForDimensions(atlas_texels_wide / tile_texels_wide);
+	for (unsigned int mipID = 0; mipID <= max_mipID; mipID++)
+	{
+		mip_level_report level;
+		level.mipID       = mipID;
+		level.texels_wide = mipmap_texels_wide_scaled(mipID, tile_texels_wide, tile_border_texels_wide);
+		level.tiles_wide  = 1u << mipID;
+		level.tiles       = (uint64_t)level.tiles_wide * level.tiles_wide;
+		level.empty_tiles = level.tiles;
+		m_levels.push_back(level);
+		m_content.push_back(std::vector<bool>((size_t)level.tiles, false));
+	}
+}
+
+void atlas_report::add_subtexture(const std::string &name, const atlas_rectangle &footprint)
+{
+	subtexture_report subtexture;
+	subtexture.name      = name;
+	subtexture.footprint = footprint;
+	m_subtextures.push_back(subtexture);
+	m_used_texels += (uint64_t)footprint.width * footprint.height;
+}
+
+void atlas_report::finish()
+{
+	for (subtexture_report &subtexture : m_subtextures)
+	{
+		subtexture.tiles_per_mipID.clear();
+		for (const mip_level_report &level : m_levels)
+		{
+			const atlas_rectangle mipmap_region = mipmap_region_for(subtexture.footprint, m_atlas_texels_wide, level.texels_wide);
+			const std::set<tile_coordinate> tiles = tiles_overlapping(mipmap_region, level.mipID, m_tile_texels_wide, m_tile_border_texels_wide);
+			subtexture.tiles_per_mipID.push_back(tiles.size());
+			for (const tile_coordinate &tile : tiles)
+			{
+				m_content[level.mipID][(size_t)tile.y * level.tiles_wide + tile.x] = true;
+			}
+		}
+	}
+	for (mip_level_report &level : m_levels)
+	{
+		level.empty_tiles = (uint64_t)std::count(m_content[level.mipID].begin(), m_content[level.mipID].end(), false);
+	}
+
+	// Uncompressed tiles are the same size whatever is in them.
+	const double raw_tile_bytes = (double)m_tile_texels_wide * m_tile_texels_wide * m_bytes_per_texel;
+	add_format_sample("raw", raw_tile_bytes, raw_tile_bytes, 0);
+}
+
+void atlas_report::add_format_sample(const std::string &format, const double &content_tile_bytes, const double &empty_tile_bytes, const uint64_t &samples)
+{
+	format_projection projection;
+	projection.format             = format;
+	projection.content_tile_bytes = content_tile_bytes;
+	projection.empty_tile_bytes   = empty_tile_bytes;
+	projection.samples            = samples;
+	projection.projected_bytes    = (uint64_t)((tiles() - empty_tiles()) * content_tile_bytes + empty_tiles() * empty_tile_bytes);
+	m_projections.push_back(projection);
+}
+
+uint64_t atlas_report::tiles() const
+{
+	uint64_t tiles = 0;
+	for (const mip_level_report &level : m_levels)
+	{
+		tiles += level.tiles;
+	}
+	return tiles;
+}
+
+uint64_t atlas_report::empty_tiles() const
+{
+	uint64_t empty_tiles = 0;
+	for (const mip_level_report &level : m_levels)
+	{
+		empty_tiles += level.empty_tiles;
+	}
+	return empty_tiles;
+}
+
+std::vector<tile_coordinate> atlas_report::content_tiles(const unsigned int &mipID, const size_t &count) const
+{
+	std::vector<tile_coordinate> all;
+	const mip_level_report &level = m_levels[mipID];
+	for (unsigned int y = 0; y < level.tiles_wide; y++)
+	{
+		for (unsigned int x = 0; x < level.tiles_wide; x++)
+		{
+			if (m_content[mipID][(size_t)y * level.tiles_wide + x])
+			{
+				all.push_back({ x, y });
+			}
+		}
+	}
+	if (all.size() <= count)
+	{
+		return all;
+	}
+	std::vector<tile_coordinate> spread;
+	for (size_t i = 0; i < count; i++)
+	{
+		spread.push_back(all[i * all.size() / count]);
+	}
+	return spread;
+}
+
+void atlas_report::print(std::ostream &out) const
+{
+	const uint64_t atlas_texels = (uint64_t)m_atlas_texels_wide * m_atlas_texels_wide;
+	out << std::fixed << std::setprecision(1)
+		<< "Atlas occupancy: " << m_occupancy * 100.0f << "% (" << m_used_texels << " of " << atlas_texels << " texels in subtextures)." << std::endl
+		<< "Tiles per mip level:" << std::endl;
+	for (const mip_level_report &level : m_levels)
+	{
+		out << " - mipID " << lead_blanks(level.mipID, 2) << ": " << lead_blanks((int)level.tiles, 9) << " tiles, " << lead_blanks((int)level.empty_tiles, 9) << " empty ("
+			<< (level.tiles ? 100.0 * level.empty_tiles / level.tiles : 0.0) << "%), level " << level.texels_wide << " texels wide." << std::endl;
+	}
+	out << " - total   : " << lead_blanks((int)tiles(), 9) << " tiles, " << lead_blanks((int)empty_tiles(), 9) << " empty (" << (tiles() ? 100.0 * empty_tiles() / tiles() : 0.0) << "%)." << std::endl
+		<< "Projected tile output:" << std::endl;
+	for (const format_projection &projection : m_projections)
+	{
+		out << " - " << lead_blanks(projection.format, 5) << ": " << projection.projected_bytes / 1048576.0 << " MiB";
+		if (projection.samples)
+		{
+			out << " (sampled " << projection.samples << " tiles, " << projection.content_tile_bytes / 1024.0 << " KiB per tile, " << projection.empty_tile_bytes / 1024.0 << " KiB per empty tile)";
+		}
+		out << "." << std::endl;
+	}
+	if (!m_estimates.empty())
+	{
+		out << "Estimates:" << std::endl;
+		for (const std::pair<std::string, uint64_t> &estimate : m_estimates)
+		{
+			out << " - " << estimate.first << ": " << estimate.second / 1048576.0 << " MiB." << std::endl;
+		}
+	}
+	out << std::defaultfloat << std::setprecision(6);
+}
+
+bool atlas_report::save_json(const std::string &file_path) const
+{
+	std::ofstream file(file_path, std::ios::trunc);
+	if (!file)
+	{
+		return false;
+	}
+	file << "{\n  \"atlas\": {\"texels_wide\": " << m_atlas_texels_wide << ", \"occupancy\": " << m_occupancy << ", \"used_texels\": " << m_used_texels
+		<< ", \"tile_texels_wide\": " << m_tile_texels_wide << ", \"tile_border_texels_wide\": " << m_tile_border_texels_wide << ", \"bytes_per_texel\": " << m_bytes_per_texel
+		<< ", \"tiles\": " << tiles() << ", \"empty_tiles\": " << empty_tiles() << "},\n";
+
+	file << "  \"levels\": [";
+	for (size_t i = 0; i < m_levels.size(); i++)
+	{
+		const mip_level_report &level = m_levels[i];
+		file << (i == 0 ? "\n" : ",\n") << "    {\"mipID\": " << level.mipID << ", \"texels_wide\": " << level.texels_wide << ", \"tiles_wide\": " << level.tiles_wide
+			<< ", \"tiles\": " << level.tiles << ", \"empty_tiles\": " << level.empty_tiles << "}";
+	}
+	file << "\n  ],\n";
+
+	file << "  \"projections\": [";
+	for (size_t i = 0; i < m_projections.size(); i++)
+	{
+		const format_projection &projection = m_projections[i];
+		file << (i == 0 ? "\n" : ",\n") << "    {\"format\": " << json_quote(projection.format) << ", \"projected_bytes\": " << projection.projected_bytes
+			<< ", \"content_tile_bytes\": " << projection.content_tile_bytes << ", \"empty_tile_bytes\": " << projection.empty_tile_bytes << ", \"samples\": " << projection.samples << "}";
+	}
+	file << "\n  ],\n";
+
+	file << "  \"estimates\": {";
+	for (size_t i = 0; i < m_estimates.size(); i++)
+	{
+		file << (i == 0 ? "" : ", ") << json_quote(m_estimates[i].first) << ": " << m_estimates[i].second;
+	}
+	file << "},\n";
+
+	file << "  \"subtextures\": [";
+	for (size_t i = 0; i < m_subtextures.size(); i++)
+	{
+		const subtexture_report &subtexture = m_subtextures[i];
+		file << (i == 0 ? "\n" : ",\n") << "    {\"name\": " << json_quote(subtexture.name)
+			<< ", \"x\": " << subtexture.footprint.x << ", \"y\": " << subtexture.footprint.y << ", \"width\": " << subtexture.footprint.width << ", \"height\": " << subtexture.footprint.height
+			<< ", \"tiles_per_mipID\": [";
+		for (size_t mipID = 0; mipID < subtexture.tiles_per_mipID.size(); mipID++)
+		{
+			file << (mipID == 0 ? "" : ", ") << subtexture.tiles_per_mipID[mipID];
+		}
+		file << "]}";
+	}
+	file << "\n  ]\n}\n";
+	return (bool)file;
+}
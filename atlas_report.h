@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ATLAS_REPORT_H
+#define ATLAS_REPORT_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "atlas_regions.h"
+
+// What a packed atlas will cost once cut into tiles, worked out from where the subtextures went: how much of the
+// atlas is used, how many tiles per mip level hold nothing at all, how many tiles each subtexture spans per mipID,
+// and what all tiles would take up in each tile format. No pixel work, apart from the optional format samples.
+
+struct mip_level_report
+{
+	unsigned int mipID;
+	unsigned int texels_wide; // Scaled down to make room for tile borders, like the mipmap level itself.
+	unsigned int tiles_wide;
+	uint64_t     tiles;
+	uint64_t     empty_tiles; // Tiles without a texel of any subtexture, border included.
+};
+
+struct subtexture_report
+{
+	std::string           name;
+	atlas_rectangle       footprint;
+	std::vector<uint64_t> tiles_per_mipID;
+};
+
+struct format_projection
+{
+	std::string format;             // File extension, or "raw" for uncompressed texels as in a raw tile pack.
+	double      content_tile_bytes; // Average over the sampled tiles.
+	double      empty_tile_bytes;
+	uint64_t    samples;            // 0 if the sizes are exact rather than sampled.
+	uint64_t    projected_bytes;
+};
+
+class atlas_report
+{
+public:
+	atlas_report(const unsigned int &atlas_texels_wide, const unsigned int &tile_texels_wide, const unsigned int &tile_border_texels_wide, const unsigned int &bytes_per_texel);
+
+	void add_subtexture(const std::string &name, const atlas_rectangle &footprint);
+	void set_occupancy(const float &occupancy) { m_occupancy = occupancy; }
+
+	// Encoded sizes of tiles with and without content in a tile format, measured on sample tiles.
+	void add_format_sample(const std::string &format, const double &content_tile_bytes, const double &empty_tile_bytes, const uint64_t &samples);
+
+	// Anything else worth knowing up front, such as the peak memory a build would take.
+	void add_estimate(const std::string &name, const uint64_t &bytes) { m_estimates.push_back({ name, bytes }); }
+
+	// Works out the tiles per level and subtexture. Call after adding all subtextures and before reading anything.
+	void finish();
+
+	float                                 occupancy() const { return m_occupancy; }
+	uint64_t                              used_texels() const { return m_used_texels; }
+	const std::vector<mip_level_report>  &levels() const { return m_levels; }
+	const std::vector<subtexture_report> &subtextures() const { return m_subtextures; }
+	const std::vector<format_projection> &projections() const { return m_projections; }
+	uint64_t                              tiles() const;
+	uint64_t                              empty_tiles() const;
+
+	// Tiles of a mipID holding some subtexture, spread evenly over the atlas, for taking format samples from.
+	std::vector<tile_coordinate> content_tiles(const unsigned int &mipID, const size_t &count) const;
+
+	// A few lines per level and format. Subtextures are only in the JSON.
+	void print(std::ostream &out) const;
+	bool save_json(const std::string &file_path) const;
+
+private:
+	unsigned int                   m_atlas_texels_wide;
+	unsigned int                   m_tile_texels_wide;
+	unsigned int                   m_tile_border_texels_wide;
+	unsigned int                   m_bytes_per_texel;
+	float                          m_occupancy;
+	uint64_t                       m_used_texels;
+	std::vector<mip_level_report>  m_levels;
+	std::vector<std::vector<bool>> m_content; // Per mipID, per tile (y * tiles_wide + x): whether it holds anything.
+	std::vector<subtexture_report> m_subtextures;
+	std::vector<format_projection> m_projections;
+	std::vector<std::pair<std::string, uint64_t>> m_estimates;
+};
+
+#endif // ATLAS_REPORT_H
@@ -0,0 +1,177 @@
+#include "build_journal.h"
+
+#include <sstream>
+#include <boost/filesystem.hpp>
+
+#include "content_hash.h"
+
+static const std::string journal_header = "vtTileCreator build journal 1";
+
+uint64_t build_key(const std::map<std::string, std::string> &parameters, const std::vector<std::pair<std::string, uint64_t>> &inputs)
+{
+	content_hasher hasher;
+	for (const auto &parameter : parameters)
+	{
+		hasher.update(parameter.first.c_str(),  parameter.first.size()  + 1); // Terminators included, so "ab" + "c" differs from "a" + "bc".
+		hasher.update(parameter.second.c_str(), parameter.second.size() + 1);
+	}
+	for (const auto &input : inputs)
+	{
+		hasher.update(input.first.c_str(), input.first.size() + 1);
+		hasher.update(&input.second, sizeof(input.second));
+	}
+	return hasher.digest();
+}
+
+bool build_journal::load(const std::string &file_path)
+{
+	m_file_path = file_path;
+	std::ifstream file(file_path);
+	std::string line;
+	if (!std::getline(file, line) || line != journal_header)
+	{
+		return false;
+	}
+
+	m_build_key = 0;
+	m_stages.clear();
+	m_placements.clear();
+	m_tile_rows.clear();
+	while (std::getline(file, line))
+	{
+		if (file.eof())
+		{
+			break; // Lines are written with their end of line, so this one got cut off.
+		}
+		std::istringstream fields(line);
+		std::string kind;
+		fields >> kind;
+		if (kind == "build")
+		{
+			std::string key;
+			fields >> key;
+			hash_from_string(key, m_build_key);
+		}
+		else if (kind == "stage")
+		{
+			std::string stage;
+			if (fields >> stage)
+			{
+				m_stages.insert(stage);
+			}
+		}
+		else if (kind == "placement")
+		{
+			manifest_subtexture placement;
+			std::string hash;
+			if (fields >> placement.x >> placement.y >> placement.texels_wide >> placement.texels_high >> hash && hash_from_string(hash, placement.content_hash))
+			{
+				fields.get(); // The space before the name, which may contain spaces itself.
+				std::getline(fields, placement.name);
+				m_placements.push_back(placement);
+			}
+		}
+		else if (kind == "tile_row")
+		{
+			unsigned int tile_mipID, tile_y;
+			if (fields >> tile_mipID >> tile_y)
+			{
+				m_tile_rows.insert({ tile_mipID, tile_y });
+			}
+		}
+	}
+	return m_build_key != 0;
+}
+
+bool build_journal::open(const std::string &file_path, const uint64_t &build_key, const bool &keep_progress)
+{
+	m_file_path = file_path;
+	if (keep_progress && build_key == m_build_key)
+	{
+		// End a line that got cut off, so it doesn't swallow the next one.
+		std::ifstream existing(file_path, std::ios::binary);
+		const bool cut_off = existing.seekg(-1, std::ios::end) && existing.get() != '\n';
+		existing.close();
+		m_file.open(file_path, std::ios::app);
+		if (cut_off)
+		{
+			m_file << '\n';
+		}
+		return m_file.good();
+	}
+
+	m_build_key = build_key;
+	m_stages.clear();
+	m_placements.clear();
+	m_tile_rows.clear();
+	m_file.open(file_path, std::ios::trunc);
+	append(journal_header);
+	append("build " + hash_to_string(build_key));
+	return m_file.good();
+}
+
+void build_journal::remove()
+{
+	m_file.close();
+	boost::system::error_code error;
+	boost::filesystem::remove(m_file_path, error);
+}
+
+bool build_journal::stage_completed(const std::string &stage) const
+{
+	return m_stages.count(stage) > 0;
+}
+
+void build_journal::complete_stage(const std::string &stage)
+{
+	m_stages.insert(stage);
+	append("stage " + stage);
+}
+
+const manifest_subtexture *build_journal::find_placement(const std::string &name) const
+{
+	for (const manifest_subtexture &placement : m_placements)
+	{
+		if (placement.name == name)
+		{
+			return &placement;
+		}
+	}
+	return nullptr;
+}
+
+void build_journal::record_placements(const std::vector<manifest_subtexture> &placements)
+{
+	m_placements = placements;
+	for (const manifest_subtexture &placement : placements)
+	{
+		append("placement " + std::to_string(placement.x) + " " + std::to_string(placement.y) + " "
+			+ std::to_string(placement.texels_wide) + " " + std::to_string(placement.texels_high) + " "
+			+ hash_to_string(placement.content_hash) + " " + placement.name);
+	}
+}
+
+bool build_journal::tile_row_completed(const unsigned int &tile_mipID, const unsigned int &tile_y) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_tile_rows.count({ tile_mipID, tile_y }) > 0;
+}
+
+void build_journal::complete_tile_row(const unsigned int &tile_mipID, const unsigned int &tile_y)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tile_rows.insert({ tile_mipID, tile_y });
+	}
+	append("tile_row " + std::to_string(tile_mipID) + " " + std::to_string(tile_y));
+}
+
+void build_journal::append(const std::string &line)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_file.is_open())
+	{
+		m_file << line << '\n';
+		m_file.flush();
+	}
+}
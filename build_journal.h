@@ -0,0 +1,68 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef BUILD_JOURNAL_H
+#define BUILD_JOURNAL_H
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "build_manifest.h"
+
+// Progress of a build that is still running, kept in the output directory so a killed build can pick up where it
+// left off. Lines are only ever appended and flushed one at a time, so the journal survives being cut off anywhere.
+// A half written last line is ignored.
+
+// Identifies a build by everything that influences its output: the parameters, and the inputs in the order given.
+uint64_t build_key(const std::map<std::string, std::string> &parameters, const std::vector<std::pair<std::string, uint64_t>> &inputs);
+
+class build_journal
+{
+public:
+	// Reads an existing journal. False if there is none.
+	bool load(const std::string &file_path);
+
+	// Starts writing to the journal. Unless progress is kept, what was in it is discarded and a new journal is started
+	// for the given build.
+	bool open(const std::string &file_path, const uint64_t &build_key, const bool &keep_progress);
+
+	// Deletes the journal, once the build is done.
+	void remove();
+
+	uint64_t build_key() const { return m_build_key; }
+
+	bool stage_completed(const std::string &stage) const;
+	void complete_stage(const std::string &stage);
+
+	// Where subtextures were placed in the atlas. Returns nullptr if there is no subtexture by that name.
+	const manifest_subtexture *find_placement(const std::string &name) const;
+	void record_placements(const std::vector<manifest_subtexture> &placements);
+
+	// Rows of tiles, by tile mipID and tile y, of which every tile was written. Safe to call from any thread.
+	bool tile_row_completed(const unsigned int &tile_mipID, const unsigned int &tile_y) const;
+	void complete_tile_row(const unsigned int &tile_mipID, const unsigned int &tile_y);
+
+private:
+	void append(const std::string &line);
+
+	std::string                                      m_file_path;
+	std::ofstream                                    m_file;
+	mutable std::mutex                               m_mutex;
+	uint64_t                                         m_build_key = 0;
+	std::set<std::string>                            m_stages;
+	std::vector<manifest_subtexture>                 m_placements;
+	std::set<std::pair<unsigned int, unsigned int>>  m_tile_rows;
+};
+
+#endif // BUILD_JOURNAL_H
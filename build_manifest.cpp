@@ -0,0 +1,85 @@
+#include "build_manifest.h"
+
+#include "content_hash.h"
+#include "pugixml/pugixml.hpp"
+
+bool build_manifest::load(const std::string &file_path)
+{
+	pugi::xml_document document;
+	if (!document.load_file(file_path.c_str()))
+	{
+		return false;
+	}
+	pugi::xml_node xml_manifest = document.child("build_manifest");
+	if (!xml_manifest)
+	{
+		return false;
+	}
+
+	parameters.clear();
+	for (pugi::xml_attribute attribute : xml_manifest.child("parameters").attributes())
+	{
+		parameters[attribute.name()] = attribute.value();
+	}
+
+	subtextures.clear();
+	for (pugi::xml_node xml_subtexture : xml_manifest.child("subtextures").children("subtexture"))
+	{
+		manifest_subtexture subtexture;
+		subtexture.name        = xml_subtexture.attribute("name").value();
+		subtexture.source_path = xml_subtexture.attribute("source_path").value();
+		subtexture.x           = xml_subtexture.attribute("x").as_uint();
+		subtexture.y           = xml_subtexture.attribute("y").as_uint();
+		subtexture.texels_wide = xml_subtexture.attribute("w").as_uint();
+		subtexture.texels_high = xml_subtexture.attribute("h").as_uint();
+		if (!hash_from_string(xml_subtexture.attribute("hash").value(), subtexture.content_hash))
+		{
+			return false;
+		}
+		subtextures.push_back(subtexture);
+	}
+	return true;
+}
+
+bool build_manifest::save(const std::string &file_path) const
+{
+	pugi::xml_document document;
+	pugi::xml_node declaration = document.append_child(pugi::node_declaration);
+	declaration.append_attribute("version") = "1.0";
+	declaration.append_attribute("encoding") = "UTF-8";
+	document.append_child(pugi::node_comment).set_value("Created by vtTileCreator. Describes what this output directory was built from. Used for incremental rebuilds.");
+
+	pugi::xml_node xml_manifest   = document.append_child("build_manifest");
+	pugi::xml_node xml_parameters = xml_manifest.append_child("parameters");
+	for (const auto &parameter : parameters)
+	{
+		xml_parameters.append_attribute(parameter.first.c_str()).set_value(parameter.second.c_str());
+	}
+
+	pugi::xml_node xml_subtextures = xml_manifest.append_child("subtextures");
+	for (const manifest_subtexture &subtexture : subtextures)
+	{
+		pugi::xml_node xml_subtexture = xml_subtextures.append_child("subtexture");
+		xml_subtexture.append_attribute("name").set_value(subtexture.name.c_str());
+		xml_subtexture.append_attribute("source_path").set_value(subtexture.source_path.c_str());
+		xml_subtexture.append_attribute("hash").set_value(hash_to_string(subtexture.content_hash).c_str());
+		xml_subtexture.append_attribute("x").set_value(subtexture.x);
+		xml_subtexture.append_attribute("y").set_value(subtexture.y);
+		xml_subtexture.append_attribute("w").set_value(subtexture.texels_wide);
+		xml_subtexture.append_attribute("h").set_value(subtexture.texels_high);
+	}
+
+	return document.save_file(file_path.c_str(), PUGIXML_TEXT("    "), pugi::format_default, pugi::encoding_utf8);
+}
+
+const manifest_subtexture *build_manifest::find(const std::string &name) const
+{
+	for (const manifest_subtexture &subtexture : subtextures)
+	{
+		if (subtexture.name == name)
+		{
+			return &subtexture;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef BUILD_MANIFEST_H
+#define BUILD_MANIFEST_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Remembers what an output directory was built from: the parameters, and for each subtexture its content hash and
+// where it was placed in the atlas. A rerun compares against it to only redo the work that changed.
+
+struct manifest_subtexture
+{
+	std::string  name;
+	std::string  source_path;
+	uint64_t     content_hash = 0;
+	unsigned int x = 0;           // Top left of the subtexture including its border, in atlas texels.
+	unsigned int y = 0;
+	unsigned int texels_wide = 0; // Including border.
+	unsigned int texels_high = 0;
+};
+
+class build_manifest
+{
+public:
+	std::map<std::string, std::string> parameters;
+	std::vector<manifest_subtexture>   subtextures;
+
+	bool load(const std::string &file_path);
+	bool save(const std::string &file_path) const;
+
+	// Returns nullptr if there is no subtexture by that name.
+	const manifest_subtexture *find(const std::string &name) const;
+};
+
+#endif // BUILD_MANIFEST_H
@@ -0,0 +1,216 @@
+#include "build_stats.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <ctime>
+#endif
+
+#include "build_trace.h"
+#include "helper_functions.h" // json_quote
+
+#if defined(_WIN32)
+static double filetime_seconds(const FILETIME &time)
+{
+	return (((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime) * 1e-7; // 100 ns units.
+}
+#endif
+
+double process_cpu_seconds()
+{
+#if defined(_WIN32)
+	FILETIME creation, exit, kernel, user;
+	GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+	return filetime_seconds(kernel) + filetime_seconds(user);
+#else
+	timespec time;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+}
+
+double thread_cpu_seconds()
+{
+#if defined(_WIN32)
+	FILETIME creation, exit, kernel, user;
+	GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+	return filetime_seconds(kernel) + filetime_seconds(user);
+#else
+	timespec time;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+}
+
+build_stats::build_stats() :
+	m_start(std::chrono::steady_clock::now()),
+	m_start_cpu_seconds(process_cpu_seconds())
+{}
+
+stage_stats &build_stats::find_or_add(const std::string &stage)
+{
+	for (stage_stats &existing : m_stages)
+	{
+		if (existing.name == stage)
+		{
+			return existing;
+		}
+	}
+	m_stages.push_back(stage_stats());
+	m_stages.back().name = stage;
+	return m_stages.back();
+}
+
+void build_stats::add(const std::string &stage, const double &wall_seconds, const double &cpu_seconds, const uint64_t &items, const uint64_t &bytes_in, const uint64_t &bytes_out)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	stage_stats &stats = find_or_add(stage);
+	stats.wall_seconds += wall_seconds;
+	stats.cpu_seconds  += cpu_seconds;
+	stats.items        += items;
+	stats.bytes_in     += bytes_in;
+	stats.bytes_out    += bytes_out;
+}
+
+void build_stats::set_threads(const std::string &stage, const unsigned int &threads)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	find_or_add(stage).threads = threads;
+}
+
+void build_stats::add_memory(const std::string &stage, const memory_window &window)
+{
+	const uint64_t devil_bytes    = window.peak_tracked_bytes();
+	const uint64_t resident_bytes = window.peak_resident_bytes();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	stage_stats &stats = find_or_add(stage);
+	stats.peak_devil_bytes    = std::max(stats.peak_devil_bytes,    devil_bytes);
+	stats.peak_resident_bytes = std::max(stats.peak_resident_bytes, resident_bytes);
+	if (devil_bytes > m_peak_devil.bytes)
+	{
+		m_peak_devil = { devil_bytes, stage };
+	}
+	// The process high water mark only goes up, so the last stage to raise it holds the peak.
+	if (window.raised_peak_resident_bytes() || resident_bytes > m_peak_resident.bytes)
+	{
+		m_peak_resident = { std::max(resident_bytes, m_peak_resident.bytes), stage };
+	}
+}
+
+void build_stats::add_perf(const std::string &stage, const perf_counts &counts)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	find_or_add(stage).perf += counts;
+}
+
+memory_peak build_stats::peak_devil() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_peak_devil;
+}
+
+memory_peak build_stats::peak_resident() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_peak_resident;
+}
+
+std::vector<stage_stats> build_stats::stages() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stages;
+}
+
+bool build_stats::save_json(const std::string &file_path, const std::map<std::string, std::string> &parameters) const
+{
+	const double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+	const double cpu_seconds  = process_cpu_seconds() - m_start_cpu_seconds;
+
+	std::ofstream file(file_path, std::ios::trunc);
+	if (!file)
+	{
+		return false;
+	}
+	file << std::setprecision(6) << std::fixed;
+	file << "{\n  \"build\": {\"wall_seconds\": " << wall_seconds << ", \"cpu_seconds\": " << cpu_seconds << "},\n";
+
+	const memory_peak devil    = peak_devil();
+	const memory_peak resident = peak_resident();
+	file << "  \"memory\": {\"peak_resident_bytes\": " << std::max(resident.bytes, ::peak_resident_bytes()) << ", \"peak_resident_stage\": " << json_quote(resident.stage)
+		<< ", \"peak_devil_bytes\": " << devil.bytes << ", \"peak_devil_stage\": " << json_quote(devil.stage)
+		<< ", \"devil_bytes_at_end\": " << tracked_bytes() << "},\n";
+
+	file << "  \"parameters\": {";
+	for (auto parameter = parameters.begin(); parameter != parameters.end(); ++parameter)
+	{
+		file << (parameter == parameters.begin() ? "" : ", ") << json_quote(parameter->first) << ": " << json_quote(parameter->second);
+	}
+	file << "},\n";
+
+	// Utilisation is how busy the stage kept the threads it had, 1 being all of them all the time.
+	file << "  \"stages\": [";
+	const std::vector<stage_stats> all_stages = stages();
+	for (size_t i = 0; i < all_stages.size(); i++)
+	{
+		const stage_stats &stage = all_stages[i];
+		const double per_second = stage.wall_seconds > 0.0 ? 1.0 / stage.wall_seconds : 0.0;
+		file << (i == 0 ? "\n" : ",\n")
+			<< "    {\"name\": " << json_quote(stage.name)
+			<< ", \"wall_seconds\": " << stage.wall_seconds
+			<< ", \"cpu_seconds\": " << stage.cpu_seconds
+			<< ", \"items\": " << stage.items
+			<< ", \"items_per_second\": " << stage.items * per_second
+			<< ", \"bytes_in\": " << stage.bytes_in
+			<< ", \"bytes_out\": " << stage.bytes_out
+			<< ", \"bytes_out_per_second\": " << stage.bytes_out * per_second
+			<< ", \"threads\": " << stage.threads
+			<< ", \"utilisation\": " << (stage.threads > 0 ? stage.cpu_seconds * per_second / stage.threads : 0.0)
+			<< ", \"peak_devil_bytes\": " << stage.peak_devil_bytes
+			<< ", \"peak_resident_bytes\": " << stage.peak_resident_bytes;
+		if (stage.perf.counted)
+		{
+			file << ", \"perf\": {";
+			for (int counter = 0; counter < perf_counter_count; counter++)
+			{
+				if (stage.perf.counted & (1u << counter))
+				{
+					file << (stage.perf.counted & ((1u << counter) - 1) ? ", " : "") << "\"" << perf_counter_name((perf_counter)counter) << "\": " << stage.perf.values[counter];
+				}
+			}
+			file << "}";
+		}
+		file << "}";
+	}
+	file << "\n  ]\n}\n";
+	return (bool)file;
+}
+
+stage_timer::stage_timer(build_stats &stats, const std::string &stage, const uint64_t &items) :
+	items(items),
+	m_stats(stats),
+	m_stage(stage),
+	m_start(std::chrono::steady_clock::now()),
+	m_start_cpu_seconds(thread_cpu_seconds()),
+	m_perf(perf_counters_enabled() && read_thread_perf_counts(m_start_perf))
+{}
+
+stage_timer::~stage_timer()
+{
+	perf_counts end_perf;
+	const bool perf = m_perf && read_thread_perf_counts(end_perf);
+	const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	m_stats.add(m_stage, std::chrono::duration<double>(end - m_start).count(), thread_cpu_seconds() - m_start_cpu_seconds, items, bytes_in, bytes_out);
+	m_stats.add_memory(m_stage, m_memory);
+	if (perf)
+	{
+		m_stats.add_perf(m_stage, end_perf - m_start_perf);
+	}
+	if (trace_enabled())
+	{
+		trace_span(m_stage, detail, m_start, end);
+	}
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef BUILD_STATS_H
+#define BUILD_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "memory_stats.h"
+#include "perf_counters.h"
+
+// Where a build spends its time and memory, per stage: wall and CPU time, items and bytes going in and out, the most
+// memory held while the stage ran and, when counting, hardware performance counters.
+// Stages may be timed piecewise, like tile cutting and encoding taking turns, and from several threads at once.
+
+double process_cpu_seconds(); // All threads.
+double thread_cpu_seconds();  // Calling thread only.
+
+struct stage_stats
+{
+	std::string  name;
+	double       wall_seconds = 0.0;
+	double       cpu_seconds  = 0.0;
+	uint64_t     items        = 0;
+	uint64_t     bytes_in     = 0;
+	uint64_t     bytes_out    = 0;
+	unsigned int threads      = 1; // Threads that could have been working on the stage, for utilisation.
+	uint64_t     peak_devil_bytes    = 0;
+	uint64_t     peak_resident_bytes = 0;
+	perf_counts  perf;
+};
+
+struct memory_peak
+{
+	uint64_t    bytes = 0;
+	std::string stage; // Which stage was running when memory use peaked.
+};
+
+class build_stats
+{
+public:
+	build_stats();
+
+	// Adds to a stage, which is created on first use. Safe to call from any thread.
+	void add(const std::string &stage, const double &wall_seconds, const double &cpu_seconds, const uint64_t &items, const uint64_t &bytes_in, const uint64_t &bytes_out);
+	void set_threads(const std::string &stage, const unsigned int &threads);
+	void add_memory(const std::string &stage, const memory_window &window);
+	void add_perf(const std::string &stage, const perf_counts &counts);
+
+	// Stages in order of first use.
+	std::vector<stage_stats> stages() const;
+	memory_peak peak_devil() const;
+	memory_peak peak_resident() const;
+
+	// Writes all stages, plus the whole build so far and what it was built with. False if the file couldn't be written.
+	bool save_json(const std::string &file_path, const std::map<std::string, std::string> &parameters) const;
+
+private:
+	stage_stats &find_or_add(const std::string &stage);
+
+	mutable std::mutex                    m_mutex;
+	std::vector<stage_stats>              m_stages;
+	memory_peak                           m_peak_devil;
+	memory_peak                           m_peak_resident;
+	std::chrono::steady_clock::time_point m_start;
+	double                                m_start_cpu_seconds;
+};
+
+// Times the enclosing scope on the calling thread and adds it to a stage when it goes out of scope.
+// Items and bytes can be filled in along the way. While tracing, the scope is also recorded as a span, described by detail.
+class stage_timer
+{
+public:
+	stage_timer(build_stats &stats, const std::string &stage, const uint64_t &items = 1);
+	~stage_timer();
+
+	uint64_t items;
+	uint64_t bytes_in  = 0;
+	uint64_t bytes_out = 0;
+	std::string detail;
+
+private:
+	build_stats                          &m_stats;
+	std::string                           m_stage;
+	std::chrono::steady_clock::time_point m_start;
+	double                                m_start_cpu_seconds;
+	memory_window                         m_memory;
+	perf_counts                           m_start_perf;
+	bool                                  m_perf;
+};
+
+#endif // BUILD_STATS_H
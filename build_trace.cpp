@@ -0,0 +1,132 @@
+#include "build_trace.h"
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "helper_functions.h" // json_quote
+
+std::atomic<bool> trace_recording(false);
+
+struct trace_event
+{
+	std::string name;
+	std::string detail;
+	int64_t     start_ns;
+	int64_t     duration_ns;
+	bool        async;
+};
+
+// Only its own thread adds to a buffer. The mutex is there for saving, which may happen while threads still run.
+struct trace_thread_buffer
+{
+	unsigned int             thread_id;
+	std::string              thread_name;
+	std::vector<trace_event> events;
+	std::mutex               mutex;
+};
+
+static std::mutex                                        trace_buffers_mutex;
+static std::vector<std::shared_ptr<trace_thread_buffer>> trace_buffers; // Outlive their threads.
+static trace_time                                        trace_start_time;
+
+// The calling thread's buffer, registered on first use.
+static trace_thread_buffer &thread_buffer()
+{
+	thread_local std::shared_ptr<trace_thread_buffer> buffer;
+	if (!buffer)
+	{
+		buffer = std::make_shared<trace_thread_buffer>();
+		buffer->events.reserve(4096);
+		std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+		buffer->thread_id = (unsigned int)trace_buffers.size() + 1;
+		trace_buffers.push_back(buffer);
+	}
+	return *buffer;
+}
+
+void trace_start()
+{
+	{
+		std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+		trace_start_time = std::chrono::steady_clock::now();
+	}
+	trace_recording = true;
+}
+
+void trace_thread_name(const std::string &name)
+{
+	trace_thread_buffer &buffer = thread_buffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.thread_name = name;
+}
+
+static void record(const std::string &name, const std::string &detail, const trace_time &start, const trace_time &end, const bool &async)
+{
+	trace_thread_buffer &buffer = thread_buffer();
+	trace_event event;
+	event.name        = name;
+	event.detail      = detail;
+	event.start_ns    = std::chrono::duration_cast<std::chrono::nanoseconds>(start - trace_start_time).count();
+	event.duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	event.async       = async;
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.events.push_back(std::move(event));
+}
+
+void trace_span(const std::string &name, const std::string &detail, const trace_time &start, const trace_time &end)
+{
+	record(name, detail, start, end, false);
+}
+
+void trace_async_span(const std::string &name, const std::string &detail, const trace_time &start, const trace_time &end)
+{
+	record(name, detail, start, end, true);
+}
+
+bool trace_save(const std::string &file_path)
+{
+	std::ofstream file(file_path, std::ios::trunc);
+	if (!file)
+	{
+		return false;
+	}
+
+	std::vector<std::shared_ptr<trace_thread_buffer>> buffers;
+	{
+		std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+		buffers = trace_buffers;
+	}
+
+	// Timestamps are in microseconds. Async spans are begin and end pairs, told apart by id.
+	file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+	bool first = true;
+	uint64_t async_id = 0;
+	auto separator = [&]() { file << (first ? "\n" : ",\n"); first = false; };
+	for (const std::shared_ptr<trace_thread_buffer> &buffer : buffers)
+	{
+		std::lock_guard<std::mutex> lock(buffer->mutex);
+		const std::string thread_name = buffer->thread_name.empty() ? "thread " + std::to_string(buffer->thread_id) : buffer->thread_name;
+		separator();
+		file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->thread_id << ", \"args\": {\"name\": " << json_quote(thread_name) << "}}";
+		for (const trace_event &event : buffer->events)
+		{
+			const std::string common = "\"name\": " + json_quote(event.name) + ", \"cat\": \"vtTileCreator\", \"pid\": 1, \"tid\": " + std::to_string(buffer->thread_id);
+			const std::string args   = event.detail.empty() ? std::string() : ", \"args\": {\"detail\": " + json_quote(event.detail) + "}";
+			separator();
+			if (!event.async)
+			{
+				file << "{" << common << ", \"ph\": \"X\", \"ts\": " << event.start_ns / 1000.0 << ", \"dur\": " << event.duration_ns / 1000.0 << args << "}";
+				continue;
+			}
+			async_id++;
+			file << "{" << common << ", \"ph\": \"b\", \"id\": " << async_id << ", \"ts\": " << event.start_ns / 1000.0 << args << "},\n"
+				<< "{" << common << ", \"ph\": \"e\", \"id\": " << async_id << ", \"ts\": " << (event.start_ns + event.duration_ns) / 1000.0 << "}";
+		}
+	}
+	file << "\n]}\n";
+	return (bool)file;
+}
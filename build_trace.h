@@ -0,0 +1,61 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef BUILD_TRACE_H
+#define BUILD_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// Spans of work per thread, saved in the Chrome trace event format to open in chrome://tracing or Perfetto.
+// Every thread records into a buffer of its own, so recording takes no locks worth mentioning. Until tracing is
+// started, recording a span costs one check.
+
+typedef std::chrono::steady_clock::time_point trace_time;
+
+extern std::atomic<bool> trace_recording;
+inline bool trace_enabled() { return trace_recording.load(std::memory_order_relaxed); }
+
+void trace_start();
+
+// Names the calling thread in the trace.
+void trace_thread_name(const std::string &name);
+
+// A span on the calling thread. Spans of one thread should nest, like scopes do.
+void trace_span(const std::string &name, const std::string &detail, const trace_time &start, const trace_time &end);
+
+// A span that may overlap others of the calling thread, like asynchronous I/O. Shown on a track of its own.
+void trace_async_span(const std::string &name, const std::string &detail, const trace_time &start, const trace_time &end);
+
+// Writes everything recorded by all threads so far. False if the file couldn't be written.
+bool trace_save(const std::string &file_path);
+
+// Records the enclosing scope as a span.
+class trace_scope
+{
+public:
+	explicit trace_scope(const char *name, const std::string &detail = std::string()) :
+		m_name(name),
+		m_detail(trace_enabled() ? detail : std::string()),
+		m_start(trace_enabled() ? std::chrono::steady_clock::now() : trace_time())
+	{}
+	~trace_scope()
+	{
+		if (trace_enabled())
+		{
+			trace_span(m_name, m_detail, m_start, std::chrono::steady_clock::now());
+		}
+	}
+
+private:
+	const char  *m_name;
+	std::string  m_detail;
+	trace_time   m_start;
+};
+
+#endif // BUILD_TRACE_H
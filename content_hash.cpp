@@ -0,0 +1,199 @@
+#include "content_hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// XXH64 by Yann Collet, reimplemented from its specification.
+static const uint64_t prime_1 = 11400714785074694791ULL;
+static const uint64_t prime_2 = 14029467366897019727ULL;
+static const uint64_t prime_3 =  1609587929392839161ULL;
+static const uint64_t prime_4 =  9650029242287828579ULL;
+static const uint64_t prime_5 =  2870177450012600261ULL;
+
+static inline uint64_t rotate_left(const uint64_t &value, const int &bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t read_64(const uint8_t *data)
+{
+	uint64_t value;
+	std::memcpy(&value, data, sizeof(value)); // Assumes a little-endian machine, as does the rest of this program.
+	return value;
+}
+
+static inline uint32_t read_32(const uint8_t *data)
+{
+	uint32_t value;
+	std::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static inline uint64_t xxh_round(uint64_t accumulator, const uint64_t &input)
+{
+	accumulator += input * prime_2;
+	accumulator  = rotate_left(accumulator, 31);
+	return accumulator * prime_1;
+}
+
+static inline uint64_t merge_round(uint64_t accumulator, const uint64_t &value)
+{
+	accumulator ^= xxh_round(0, value);
+	return accumulator * prime_1 + prime_4;
+}
+
+content_hasher::content_hasher(const uint64_t &seed) :
+	m_buffered(0),
+	m_total(0),
+	m_seed(seed)
+{
+	m_accumulators[0] = seed + prime_1 + prime_2;
+	m_accumulators[1] = seed + prime_2;
+	m_accumulators[2] = seed;
+	m_accumulators[3] = seed - prime_1;
+}
+
+void content_hasher::update(const void *data, const size_t &size)
+{
+	const uint8_t *bytes = static_cast<const uint8_t*>(data);
+	const uint8_t *end   = bytes + size;
+	m_total += size;
+
+	// Top up a partially filled stripe first.
+	if (m_buffered > 0)
+	{
+		const size_t fill = std::min(sizeof(m_buffer) - m_buffered, size);
+		std::memcpy(m_buffer + m_buffered, bytes, fill);
+		m_buffered += fill;
+		bytes      += fill;
+		if (m_buffered < sizeof(m_buffer))
+		{
+			return;
+		}
+		for (int lane = 0; lane < 4; lane++)
+		{
+			m_accumulators[lane] = xxh_round(m_accumulators[lane], read_64(m_buffer + 8 * lane));
+		}
+		m_buffered = 0;
+	}
+
+	// Whole stripes straight from the input.
+	while (end - bytes >= 32)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			m_accumulators[lane] = xxh_round(m_accumulators[lane], read_64(bytes + 8 * lane));
+		}
+		bytes += 32;
+	}
+
+	std::memcpy(m_buffer, bytes, end - bytes);
+	m_buffered = end - bytes;
+}
+
+uint64_t content_hasher::digest() const
+{
+	uint64_t hash;
+	if (m_total >= 32)
+	{
+		hash = rotate_left(m_accumulators[0], 1) + rotate_left(m_accumulators[1], 7) + rotate_left(m_accumulators[2], 12) + rotate_left(m_accumulators[3], 18);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			hash = merge_round(hash, m_accumulators[lane]);
+		}
+	}
+	else
+	{
+		hash = m_seed + prime_5;
+	}
+	hash += m_total;
+
+	const uint8_t *bytes = m_buffer;
+	const uint8_t *end   = m_buffer + m_buffered;
+	while (end - bytes >= 8)
+	{
+		hash ^= xxh_round(0, read_64(bytes));
+		hash  = rotate_left(hash, 27) * prime_1 + prime_4;
+		bytes += 8;
+	}
+	if (end - bytes >= 4)
+	{
+		hash ^= (uint64_t)read_32(bytes) * prime_1;
+		hash  = rotate_left(hash, 23) * prime_2 + prime_3;
+		bytes += 4;
+	}
+	while (bytes < end)
+	{
+		hash ^= (*bytes) * prime_5;
+		hash  = rotate_left(hash, 11) * prime_1;
+		bytes++;
+	}
+
+	hash ^= hash >> 33;
+	hash *= prime_2;
+	hash ^= hash >> 29;
+	hash *= prime_3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+uint64_t hash_bytes(const void *data, const size_t &size, const uint64_t &seed)
+{
+	content_hasher hasher(seed);
+	hasher.update(data, size);
+	return hasher.digest();
+}
+
+bool hash_file(const std::string &file_path, uint64_t &hash)
+{
+	std::ifstream file(file_path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	content_hasher hasher;
+	std::vector<char> chunk(1 << 20);
+	while (file)
+	{
+		file.read(chunk.data(), chunk.size());
+		hasher.update(chunk.data(), (size_t)file.gcount());
+	}
+	if (!file.eof())
+	{
+		return false;
+	}
+	hash = hasher.digest();
+	return true;
+}
+
+std::string hash_to_string(const uint64_t &hash)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string string(16, '0');
+	for (int i = 0; i < 16; i++)
+	{
+		string[15 - i] = digits[(hash >> (4 * i)) & 0xF];
+	}
+	return string;
+}
+
+bool hash_from_string(const std::string &string, uint64_t &hash)
+{
+	if (string.size() != 16)
+	{
+		return false;
+	}
+	uint64_t value = 0;
+	for (const char &character : string)
+	{
+		value <<= 4;
+		if      (character >= '0' && character <= '9') value |= (uint64_t)(character - '0');
+		else if (character >= 'a' && character <= 'f') value |= (uint64_t)(character - 'a' + 10);
+		else return false;
+	}
+	hash = value;
+	return true;
+}
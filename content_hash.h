@@ -0,0 +1,37 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64 bit XXH64 content hashing, for telling whether inputs changed between runs. Not cryptographic.
+class content_hasher
+{
+public:
+	explicit content_hasher(const uint64_t &seed = 0);
+
+	void     update(const void *data, const size_t &size);
+	uint64_t digest() const;
+
+private:
+	uint64_t m_accumulators[4];
+	uint8_t  m_buffer[32];
+	size_t   m_buffered;
+	uint64_t m_total;
+	uint64_t m_seed;
+};
+
+uint64_t    hash_bytes(const void *data, const size_t &size, const uint64_t &seed = 0);
+bool        hash_file(const std::string &file_path, uint64_t &hash);
+std::string hash_to_string(const uint64_t &hash); // 16 hexadecimal digits.
+bool        hash_from_string(const std::string &string, uint64_t &hash);
+
+#endif // CONTENT_HASH_H
@@ -1,5 +1,5 @@
 #include "helper_functions.h"
-//#include <ctime>   // Timestamp
+#include <ctime>   // Timestamp
 #include <sstream> // Leading zeroes
 #include <string>
 #include <iomanip> // Leading zeroes & Timestamp
@@ -40,7 +40,11 @@ std::string current_timestamp()
 {
 	time_t t = time(0); // Gets current time.
 	tm now;
+#ifdef _WIN32
 	localtime_s(&now, &t); // Converts to local time incl. attributes like year, month, etc.
+#else
+	localtime_r(&t, &now);
+#endif
 	std::string stamp =
 		lead_zeroes(now.tm_year + 1900, 4)
 		+ '-' + lead_zeroes(now.tm_mon + 1, 2)
@@ -78,3 +82,17 @@ unsigned int numberOfMipLevelsForDimensions(unsigned int dimensions)
 {
 	return mipIDForDimensions(dimensions) + 1;
 }
+
+std::string json_quote(const std::string& string)
+{
+	std::ostringstream quoted;
+	quoted << '"';
+	for (const char& c : string)
+	{
+		if      (c == '"' || c == '\\')   quoted << '\\' << c;
+		else if ((unsigned char)c < 0x20) quoted << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec;
+		else                              quoted << c;
+	}
+	quoted << '"';
+	return quoted.str();
+}
@@ -1,6 +1,7 @@
 #ifndef HELPER_FUNCTIONS_H
 #define HELPER_FUNCTIONS_H
 
+#include <cmath>
 #include <string>
 
 std::string lead_character(const std::string& string, const int& number_of_characters, const char& leading_character);
@@ -12,6 +13,9 @@ std::string lead_zeroes(const int& integer, const int& number_of_characters);
 
 std::string current_timestamp();
 
+// Quoted and escaped for use as a JSON string.
+std::string json_quote(const std::string& string);
+
 inline int positive_modulo(int i, int n) {
 	return (i % n + n) % n;
 }
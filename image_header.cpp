@@ -0,0 +1,125 @@
+#include "image_header.h"
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+static inline unsigned int big_endian_16(const uint8_t *data)    { return ((unsigned int)data[0] << 8) | data[1]; }
+static inline unsigned int big_endian_32(const uint8_t *data)    { return ((unsigned int)data[0] << 24) | ((unsigned int)data[1] << 16) | ((unsigned int)data[2] << 8) | data[3]; }
+static inline unsigned int little_endian_16(const uint8_t *data) { return data[0] | ((unsigned int)data[1] << 8); }
+static inline int32_t      little_endian_32(const uint8_t *data) { return (int32_t)(data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24)); }
+
+static bool read_png_header(const uint8_t *data, const size_t &size, image_header &header)
+{
+	// Signature, then the IHDR chunk: length, type, width, height, bit depth, colour type.
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	if (size < 26 || std::memcmp(data, signature, 8) != 0 || std::memcmp(data + 12, "IHDR", 4) != 0)
+	{
+		return false;
+	}
+	header.texels_wide = big_endian_32(data + 16);
+	header.texels_high = big_endian_32(data + 20);
+	switch (data[25])
+	{
+	case 0:  header.channels = 1; break;
+	case 4:  header.channels = 2; break;
+	case 6:  header.channels = 4; break;
+	default: header.channels = 3; break; // RGB or palette.
+	}
+	return true;
+}
+
+static bool read_jpeg_header(std::ifstream &file, image_header &header)
+{
+	// Walk the markers up to the first start of frame. Everything in between has a length, except the ones without.
+	uint8_t marker[4];
+	file.seekg(2);
+	while (file.read((char *)marker, 4))
+	{
+		if (marker[0] != 0xff)
+		{
+			return false;
+		}
+		if (marker[1] == 0xff)
+		{
+			file.seekg(-3, std::ios::cur); // Fill byte.
+			continue;
+		}
+		if ((marker[1] >= 0xd0 && marker[1] <= 0xd7) || marker[1] == 0x01)
+		{
+			file.seekg(-2, std::ios::cur); // No length.
+			continue;
+		}
+		const unsigned int length = big_endian_16(marker + 2);
+		if (marker[1] >= 0xc0 && marker[1] <= 0xcf && marker[1] != 0xc4 && marker[1] != 0xc8 && marker[1] != 0xcc)
+		{
+			uint8_t frame[6]; // Precision, height, width, components.
+			if (!file.read((char *)frame, 6))
+			{
+				return false;
+			}
+			header.texels_high = big_endian_16(frame + 1);
+			header.texels_wide = big_endian_16(frame + 3);
+			header.channels    = frame[5];
+			return true;
+		}
+		if (length < 2)
+		{
+			return false;
+		}
+		file.seekg(length - 2, std::ios::cur);
+	}
+	return false;
+}
+
+static bool read_bmp_header(const uint8_t *data, const size_t &size, image_header &header)
+{
+	if (size < 30 || data[0] != 'B' || data[1] != 'M' || little_endian_32(data + 14) < 40)
+	{
+		return false; // Not a BITMAPINFOHEADER or later, which is all DevIL writes anyway.
+	}
+	const int32_t height = little_endian_32(data + 22); // Negative for top down bitmaps.
+	header.texels_wide = (unsigned int)little_endian_32(data + 18);
+	header.texels_high = (unsigned int)(height < 0 ? -height : height);
+	header.channels    = little_endian_16(data + 28) == 32 ? 4 : 3;
+	return true;
+}
+
+static bool read_tga_header(const uint8_t *data, const size_t &size, const std::string &file_path, image_header &header)
+{
+	// TGA has no signature, so go by extension and a sane image type.
+	const size_t dot = file_path.find_last_of('.');
+	std::string extension = dot == std::string::npos ? "" : file_path.substr(dot);
+	for (char &c : extension)
+	{
+		c = (char)::tolower(c);
+	}
+	const uint8_t image_type = data[2] & ~8; // Without the run length encoding bit.
+	if (size < 18 || extension != ".tga" || image_type < 1 || image_type > 3)
+	{
+		return false;
+	}
+	header.texels_wide = little_endian_16(data + 12);
+	header.texels_high = little_endian_16(data + 14);
+	header.channels    = image_type == 1 ? 3 : (data[16] + 7) / 8;
+	return true;
+}
+
+bool read_image_header(const std::string &file_path, image_header &header)
+{
+	std::ifstream file(file_path, std::ios::binary);
+	uint8_t data[32];
+	file.read((char *)data, sizeof(data));
+	const size_t size = (size_t)file.gcount();
+	if (size < 4)
+	{
+		return false;
+	}
+	if (data[0] == 0xff && data[1] == 0xd8)
+	{
+		file.clear();
+		return read_jpeg_header(file, header);
+	}
+	return read_png_header(data, size, header) || read_bmp_header(data, size, header) || read_tga_header(data, size, file_path, header);
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef IMAGE_HEADER_H
+#define IMAGE_HEADER_H
+
+#include <string>
+
+// Image dimensions read from the first bytes of a file, without decoding a single texel.
+// Knows PNG, JPEG, BMP and TGA. Anything else is up to DevIL to decode.
+struct image_header
+{
+	unsigned int texels_wide = 0;
+	unsigned int texels_high = 0;
+	unsigned int channels    = 0; // As stored: 1 for grey, 3 for RGB and palettes, 4 with alpha.
+};
+
+// False if the file can't be read or isn't in one of the formats above.
+bool read_image_header(const std::string &file_path, image_header &header);
+
+#endif // IMAGE_HEADER_H
@@ -0,0 +1,302 @@
+#include "image_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <IL/ilu.h>
+
+#include "helper_functions.h" // positive_modulo
+
+// The per texel kernels, specialised for a channel type and count so the compiler can unroll and vectorise the
+// inner loops instead of going over vt_atlas_bpp bytes one at a time. Texels are stored row by row from the top.
+
+// Fills the border of the image with texels wrapped around from the opposite side of the non-border part. With
+// fixed_channels 0 the channel count is only known at run time, which is the slow path for unusual layouts.
+template <typename channel_t, unsigned int fixed_channels>
+static void wrap_border_channels(uint8_t *bytes, const unsigned int &texels_wide, const unsigned int &texels_high, const unsigned int &border_texels_wide, const unsigned int &runtime_channels)
+{
+	const unsigned int channels = fixed_channels != 0 ? fixed_channels : runtime_channels;
+	channel_t *texels = reinterpret_cast<channel_t*>(bytes);
+
+	// Act as if the non-border texels are their own image with its own coordinate system starting at its top left texel.
+	const int non_border_image_width  = texels_wide - 2 * border_texels_wide;
+	const int non_border_image_height = texels_high - 2 * border_texels_wide;
+
+	for (unsigned int y = 0; y < texels_high; y++)
+	{
+		const int wrapped_y = positive_modulo((int)y - (int)border_texels_wide, non_border_image_height) + border_texels_wide;
+		channel_t *row         = texels + (size_t)y         * texels_wide * channels;
+		channel_t *wrapped_row = texels + (size_t)wrapped_y * texels_wide * channels;
+
+		// Rows in between the top and bottom border only have border texels at either end.
+		const bool border_row = y < border_texels_wide || y >= texels_high - border_texels_wide;
+		for (unsigned int x = 0; x < texels_wide; x++)
+		{
+			if (!border_row && x == border_texels_wide)
+			{
+				x = std::max(x, texels_wide - border_texels_wide);
+				if (x >= texels_wide)
+				{
+					break;
+				}
+			}
+			const int wrapped_x = positive_modulo((int)x - (int)border_texels_wide, non_border_image_width) + border_texels_wide;
+			for (unsigned int c = 0; c < channels; c++)
+			{
+				row[x * channels + c] = wrapped_row[wrapped_x * channels + c];
+			}
+		}
+	}
+}
+
+template <typename channel_t, unsigned int channels>
+static void wrap_border_texels(uint8_t *bytes, const unsigned int &texels_wide, const unsigned int &texels_high, const unsigned int &border_texels_wide)
+{
+	wrap_border_channels<channel_t, channels>(bytes, texels_wide, texels_high, border_texels_wide, channels);
+}
+
+// Copies a rectangle of texels from one image into another of the same layout.
+template <typename channel_t, unsigned int channels>
+static void copy_texels(const uint8_t *source, const unsigned int &source_texels_wide, const unsigned int &source_x, const unsigned int &source_y,
+	uint8_t *destination, const unsigned int &destination_texels_wide, const unsigned int &destination_x, const unsigned int &destination_y,
+	const unsigned int &texels_wide, const unsigned int &texels_high)
+{
+	const size_t texel_bytes = sizeof(channel_t) * channels;
+	for (unsigned int y = 0; y < texels_high; y++)
+	{
+		std::memcpy(
+			destination + ((size_t)(destination_y + y) * destination_texels_wide + destination_x) * texel_bytes,
+			source      + ((size_t)(source_y      + y) * source_texels_wide      + source_x     ) * texel_bytes,
+			texels_wide * texel_bytes);
+	}
+}
+
+struct texel_kernels
+{
+	void (*wrap_border)(uint8_t *bytes, const unsigned int &texels_wide, const unsigned int &texels_high, const unsigned int &border_texels_wide);
+	void (*copy)(const uint8_t *source, const unsigned int &source_texels_wide, const unsigned int &source_x, const unsigned int &source_y,
+		uint8_t *destination, const unsigned int &destination_texels_wide, const unsigned int &destination_x, const unsigned int &destination_y,
+		const unsigned int &texels_wide, const unsigned int &texels_high);
+};
+
+template <typename channel_t, unsigned int channels>
+static texel_kernels texel_kernels_for()
+{
+	return { &wrap_border_texels<channel_t, channels>, &copy_texels<channel_t, channels> };
+}
+
+// One entry per supported layout, by channel count. Only 8 bit channels so far: 16 bit or half float layouts
+// would get a table of their own once texel_layout can describe them.
+static const texel_kernels unsigned_byte_kernels[4] = {
+	texel_kernels_for<uint8_t, 1>(),
+	texel_kernels_for<uint8_t, 2>(),
+	texel_kernels_for<uint8_t, 3>(),
+	texel_kernels_for<uint8_t, 4>(),
+};
+
+static const texel_kernels *texel_kernels_for(const ILenum &type, const unsigned int &bytes_per_texel)
+{
+	if (type != IL_UNSIGNED_BYTE || bytes_per_texel < 1 || bytes_per_texel > 4)
+	{
+		return nullptr;
+	}
+	return &unsigned_byte_kernels[bytes_per_texel - 1];
+}
+
+// Whether texels can be copied straight between the images, rather than through ilBlit or ilOverlayImage. DevIL
+// converts differing formats, flips lower left origins and blends texels with alpha when IL_BLIT_BLEND is on, all
+// of which I leave to it so results don't change.
+static const texel_kernels *copy_kernels_for(ilImage &destination, ilImage &source)
+{
+	if (source.Format() != destination.Format() || source.Type() != destination.Type()
+		|| source.GetOrigin() != IL_ORIGIN_UPPER_LEFT || destination.GetOrigin() != IL_ORIGIN_UPPER_LEFT)
+	{
+		return nullptr;
+	}
+	const bool has_alpha = source.Format() == IL_RGBA || source.Format() == IL_BGRA || source.Format() == IL_LUMINANCE_ALPHA;
+	if (has_alpha && ilIsEnabled(IL_BLIT_BLEND))
+	{
+		return nullptr;
+	}
+	return texel_kernels_for(source.Type(), source.Bpp());
+}
+
+bool texel_layout_from_string(const std::string &name, texel_layout &layout)
+{
+	std::string lower = name;
+	std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+	if      (lower == "r")    layout = texel_layout_for_channels(1);
+	else if (lower == "rg")   layout = texel_layout_for_channels(2);
+	else if (lower == "rgb")  layout = texel_layout_for_channels(3);
+	else if (lower == "rgba") layout = texel_layout_for_channels(4);
+	else return false;
+	return true;
+}
+
+texel_layout texel_layout_for_channels(const unsigned int &channels)
+{
+	switch (channels)
+	{
+		case 1:  return { 1, IL_LUMINANCE,       IL_UNSIGNED_BYTE };
+		case 2:  return { 2, IL_LUMINANCE_ALPHA, IL_UNSIGNED_BYTE };
+		case 3:  return { 3, IL_RGB,             IL_UNSIGNED_BYTE };
+		default: return { 4, IL_RGBA,            IL_UNSIGNED_BYTE };
+	}
+}
+
+void convert_to_layout(ilImage &image, const texel_layout &layout)
+{
+	if (image.Format() == layout.format && image.Type() == layout.type)
+	{
+		return;
+	}
+	image.Bind();
+	if ((layout.format != IL_LUMINANCE && layout.format != IL_LUMINANCE_ALPHA)
+		|| (layout.format == IL_LUMINANCE_ALPHA && image.Format() == IL_LUMINANCE_ALPHA)) // Grey and alpha, like a packed roughness/metal map, already are the two channels.
+	{
+		ilConvertImage(layout.format, layout.type);
+		return;
+	}
+
+	// Pick R (and G) out of RGBA myself. Greyscale sources end up the same either way.
+	ilConvertImage(IL_RGBA, IL_UNSIGNED_BYTE);
+	const size_t   texels = (size_t)image.Width() * image.Height();
+	const ILubyte *rgba   = image.GetData();
+	std::vector<ILubyte> picked(texels * layout.bytes_per_texel);
+	for (size_t i = 0; i < texels; i++)
+	{
+		for (int c = 0; c < layout.bytes_per_texel; c++)
+		{
+			picked[i * layout.bytes_per_texel + c] = rgba[i * 4 + c];
+		}
+	}
+	ilState::Enable(IL_ORIGIN_SET);
+	ilState::Origin(image.GetOrigin()); // Prevent image getting flipped vertically.
+	image.TexImage(image.Width(), image.Height(), 1, layout.bytes_per_texel, layout.format, layout.type, picked.data());
+}
+
+void add_inset_border(ilImage &image, const unsigned int &border_texels_wide, const texel_layout &layout)
+{
+	// Anything else would get converted by ilOverlayImage below, the DevIL way.
+	convert_to_layout(image, layout);
+
+	const unsigned int texels_wide = image.Width();
+	const unsigned int texels_high = image.Height();
+
+	// Scale down current image (because border will be inset).
+	iluImageParameter(ILU_FILTER, ILU_BILINEAR); // Sufficient quality filter for downscaling according to DevIL docs. Sidenote: Couldn't find this function in DevIL C++ Wrapper.
+	image.Resize(texels_wide - 2 * border_texels_wide, texels_high - 2 * border_texels_wide, 1); // New size
+
+	// Make temporal copy of scaled down image.
+	ilState::Enable(IL_ORIGIN_SET);
+	ilState::Origin(image.GetOrigin()); // Prevent image getting flipped vertically.
+	ilImage bordered_image;
+	bordered_image.TexImage(texels_wide, texels_high, 1, layout.bytes_per_texel, layout.format, layout.type, NULL);
+	bordered_image.Bind();
+	ilClearImage(); // Just to get rid off garbage values. Nice for debugging.
+
+	// Copy the scaled down original image over leaving borders uncoloured for now.
+	overlay_image(bordered_image, image, border_texels_wide, border_texels_wide);
+	// Note: original image is now no longer required.
+
+	// Fill the border with texels wrapped around from the just copied image data.
+	const texel_kernels *kernels = texel_kernels_for(layout.type, layout.bytes_per_texel);
+	if (kernels)
+	{
+		kernels->wrap_border(bordered_image.GetData(), texels_wide, texels_high, border_texels_wide);
+	}
+	else
+	{
+		// No kernel for this layout, so copy it byte by byte.
+		bordered_image.Bind();
+		const unsigned int bytes_per_texel = ilGetInteger(IL_IMAGE_BPP) * ilGetInteger(IL_IMAGE_BPC);
+		wrap_border_channels<uint8_t, 0>(bordered_image.GetData(), texels_wide, texels_high, border_texels_wide, bytes_per_texel);
+	}
+
+	// The bordered image is now finished and ready to become the new image.
+	image = bordered_image;
+}
+
+void overlay_image(ilImage &destination, ilImage &source, const unsigned int &x, const unsigned int &y)
+{
+	const texel_kernels *kernels = copy_kernels_for(destination, source);
+	if (kernels)
+	{
+		if (x < destination.Width() && y < destination.Height())
+		{
+			kernels->copy(source.GetData(), source.Width(), 0, 0, destination.GetData(), destination.Width(), x, y,
+				std::min(source.Width(), destination.Width() - x), std::min(source.Height(), destination.Height() - y));
+		}
+		return;
+	}
+	destination.Bind();
+	ilOverlayImage(source.GetId(), x, y, 0);
+}
+
+void cut_tile(ilImage &mipmap_level, const unsigned int &tile_x, const unsigned int &tile_y,
+	const unsigned int &tile_texels_wide, const unsigned int &tile_border_texels_wide, const texel_layout &layout, ilImage &tile_image)
+{
+	// Values used down the line.
+	const unsigned int payload_texels_wide     = tile_texels_wide - 2 * tile_border_texels_wide;
+	const unsigned int mipmap_level_tiles_wide = mipmap_level.Width() / payload_texels_wide; // Levels are scaled to whole tile payloads.
+
+	// Coordinates in atlas mipmap. (Minus border width is to give tiles a border with data from neighbouring tiles.)
+	const int tile_top_left_atlas_texel_x = tile_x                                 * payload_texels_wide - tile_border_texels_wide;
+	const int tile_top_left_atlas_texel_y = (mipmap_level_tiles_wide - 1 - tile_y) * payload_texels_wide - tile_border_texels_wide;
+	// Note: Tile-coordinates, like UV-coordinates, use a lower left origin (in my implementation at least).
+	//       At texel level this program uses an upper left origin for image manipulation. Unlike the x-axis, the tile-y-axis is therefore flipped above.
+
+	// Used for check whether sampling inside atlas mipmap. (See below.)
+	const int tile_lower_right_atlas_texel_x = tile_top_left_atlas_texel_x + tile_texels_wide;
+	const int tile_lower_right_atlas_texel_y = tile_top_left_atlas_texel_y + tile_texels_wide;
+
+	// We need to take care of some "edge" conditions, specifically for borders sampling outside of the texture atlas.
+	const unsigned int texels_past_left_border  = tile_top_left_atlas_texel_x     <  0                                             ? (unsigned int)( -tile_top_left_atlas_texel_x                                               ) : 0;
+	const unsigned int texels_past_upper_border = tile_top_left_atlas_texel_y     <  0                                             ? (unsigned int)( -tile_top_left_atlas_texel_y                                               ) : 0;
+	const unsigned int texels_past_right_border = tile_lower_right_atlas_texel_x >= (int)mipmap_level.Width()  ? (unsigned int)( tile_lower_right_atlas_texel_x - mipmap_level.Width()  ) : 0;
+	const unsigned int texels_past_lower_border = tile_lower_right_atlas_texel_y >= (int)mipmap_level.Height() ? (unsigned int)( tile_lower_right_atlas_texel_y - mipmap_level.Height() ) : 0;
+
+	// Create tile image.
+	tile_image.TexImage(tile_texels_wide, tile_texels_wide, 1, layout.bytes_per_texel, layout.format, layout.type, NULL);
+	tile_image.Bind();
+	ilClearImage(); // Just to get rid off garbage values. Nice for debugging.
+
+	// Copy corresponding texels from atlas mipmap level.
+	const texel_kernels *kernels = copy_kernels_for(tile_image, mipmap_level);
+	if (kernels)
+	{
+		kernels->copy(
+			mipmap_level.GetData(), mipmap_level.Width(),
+			tile_top_left_atlas_texel_x + texels_past_left_border, tile_top_left_atlas_texel_y + texels_past_upper_border,
+			tile_image.GetData(), tile_texels_wide,
+			texels_past_left_border, texels_past_upper_border,
+			tile_texels_wide - texels_past_left_border  - texels_past_right_border,
+			tile_texels_wide - texels_past_upper_border - texels_past_lower_border);
+		return;
+	}
+	ilBlit(
+		mipmap_level.GetId(),
+		0 + texels_past_left_border,                                            // destination/tile top left x
+		0 + texels_past_upper_border,                                           // destination/tile top left y
+		0,                                                                      // destination/tile top left z
+		tile_top_left_atlas_texel_x + texels_past_left_border,                  // source/atlas top left x
+		tile_top_left_atlas_texel_y + texels_past_upper_border,                 // source/atlas top left y
+		0,                                                                      // source/atlas top left z
+		tile_texels_wide - texels_past_left_border  - texels_past_right_border, // nr texels to copy x
+		tile_texels_wide - texels_past_upper_border - texels_past_lower_border, // nr texels to copy y
+		1                                                                       // nr texels to copy z
+	);
+}
+
+bool encode_image(ilImage &image, const std::string &file_extension, std::vector<uint8_t> &encoded)
+{
+	const ILenum type = ilTypeFromExt(("image" + file_extension).c_str());
+	if (type == IL_TYPE_UNKNOWN)
+	{
+		return false;
+	}
+	image.Bind();
+	encoded.resize(ilDetermineSize(type));
+	const ILuint encoded_size = ilSaveL(type, encoded.data(), (ILuint)encoded.size());
+	encoded.resize(encoded_size);
+	return encoded_size > 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef IMAGE_KERNELS_H
+#define IMAGE_KERNELS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DevIL/devil_cpp_wrapper.h"
+
+// The image operations the pipeline spends its time in, free of global configuration so the benchmarks can run
+// them with any parameters. All images use an upper left origin.
+
+// How texels are laid out: number of 8 bit channels, and the DevIL format and type that go with it.
+struct texel_layout
+{
+	ILubyte bytes_per_texel;
+	ILenum  format;
+	ILenum  type;
+};
+
+// Layouts by name: r, rg, rgb or rgba. R and RG are kept in DevIL luminance and luminance alpha images.
+bool         texel_layout_from_string(const std::string &name, texel_layout &layout);
+texel_layout texel_layout_for_channels(const unsigned int &channels);
+
+// Converts the image to the layout. R and RG take the red and green channels as they are, rather than DevIL's
+// weighted luminance, so roughness and normal maps keep their values. Luminance alpha sources keep both channels for RG.
+void convert_to_layout(ilImage &image, const texel_layout &layout);
+
+// Scales the image down by twice the border width and fills the border with texels wrapped around from the
+// opposite side, so the image tiles seamlessly when sampled across its edge. The image keeps its size and is
+// converted to the layout first.
+void add_inset_border(ilImage &image, const unsigned int &border_texels_wide, const texel_layout &layout);
+
+// Copies the whole source image into the destination image, its top left texel at x, y.
+void overlay_image(ilImage &destination, ilImage &source, const unsigned int &x, const unsigned int &y);
+
+// Copies the bordered tile at the given tile coordinates (lower left origin) out of an atlas mipmap level, which
+// is scaled to whole tile payloads. Border texels outside the level are left blank.
+void cut_tile(ilImage &mipmap_level, const unsigned int &tile_x, const unsigned int &tile_y,
+	const unsigned int &tile_texels_wide, const unsigned int &tile_border_texels_wide, const texel_layout &layout, ilImage &tile_image);
+
+// Encodes an image in memory, in the image format belonging to the given file extension.
+bool encode_image(ilImage &image, const std::string &file_extension, std::vector<uint8_t> &encoded);
+
+#endif // IMAGE_KERNELS_H
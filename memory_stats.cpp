@@ -0,0 +1,175 @@
+#include "memory_stats.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+static std::atomic<uint64_t> current_tracked_bytes(0);
+static std::atomic<uint64_t> highest_tracked_bytes(0);
+static std::atomic<uint64_t> last_resident_sample(0); // Kept up to date by memory_sampler.
+
+// Constructed on first use, since DevIL allocates during static initialisation.
+struct memory_window_registry
+{
+	std::mutex                  mutex;
+	std::vector<memory_window*> windows;
+};
+static memory_window_registry &window_registry()
+{
+	static memory_window_registry registry;
+	return registry;
+}
+
+static void raise_to(std::atomic<uint64_t> &peak, const uint64_t &bytes)
+{
+	uint64_t previous = peak.load();
+	while (previous < bytes && !peak.compare_exchange_weak(previous, bytes)) {}
+}
+
+// Every block starts with its size, padded to keep the alignment malloc gives.
+static const size_t tracked_header_bytes = 16;
+
+void *tracked_alloc(const size_t &bytes)
+{
+	uint8_t *block = static_cast<uint8_t*>(std::malloc(bytes + tracked_header_bytes));
+	if (!block)
+	{
+		return nullptr;
+	}
+	*reinterpret_cast<size_t*>(block) = bytes;
+
+	const uint64_t now_tracked = current_tracked_bytes += bytes;
+	raise_to(highest_tracked_bytes, now_tracked);
+	memory_window_registry &registry = window_registry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	for (memory_window *window : registry.windows)
+	{
+		window->update_tracked(now_tracked);
+	}
+	return block + tracked_header_bytes;
+}
+
+void tracked_free(const void *pointer)
+{
+	if (!pointer)
+	{
+		return;
+	}
+	uint8_t *block = const_cast<uint8_t*>(static_cast<const uint8_t*>(pointer)) - tracked_header_bytes;
+	current_tracked_bytes -= *reinterpret_cast<size_t*>(block);
+	std::free(block);
+}
+
+uint64_t tracked_bytes()      { return current_tracked_bytes; }
+uint64_t peak_tracked_bytes() { return highest_tracked_bytes; }
+
+uint64_t resident_bytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize : 0;
+#else
+	// Second number is resident pages. Linux only, elsewhere this reads nothing.
+	std::ifstream statm("/proc/self/statm");
+	uint64_t size_pages = 0, resident_pages = 0;
+	statm >> size_pages >> resident_pages;
+	return resident_pages * (uint64_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+uint64_t peak_resident_bytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+#if defined(__APPLE__)
+	return (uint64_t)usage.ru_maxrss;        // Bytes.
+#else
+	return (uint64_t)usage.ru_maxrss * 1024; // KiB.
+#endif
+#endif
+}
+
+memory_window::memory_window() :
+	m_peak_tracked_bytes(current_tracked_bytes.load()),
+	m_peak_resident_bytes(last_resident_sample.load()),
+	m_start_peak_resident_bytes(::peak_resident_bytes())
+{
+	memory_window_registry &registry = window_registry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.windows.push_back(this);
+}
+
+memory_window::~memory_window()
+{
+	memory_window_registry &registry = window_registry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.windows.erase(std::find(registry.windows.begin(), registry.windows.end(), this));
+}
+
+uint64_t memory_window::peak_resident_bytes() const
+{
+	// A new high of the whole process while this window was open is a peak this window saw.
+	const uint64_t process_peak = ::peak_resident_bytes();
+	const uint64_t sampled_peak = std::max(m_peak_resident_bytes.load(), last_resident_sample.load());
+	return process_peak > m_start_peak_resident_bytes ? std::max(process_peak, sampled_peak) : sampled_peak;
+}
+
+bool memory_window::raised_peak_resident_bytes() const
+{
+	return ::peak_resident_bytes() > m_start_peak_resident_bytes;
+}
+
+void memory_window::update_tracked(const uint64_t &bytes)
+{
+	raise_to(m_peak_tracked_bytes, bytes);
+}
+
+void memory_window::update_resident(const uint64_t &bytes)
+{
+	raise_to(m_peak_resident_bytes, bytes);
+}
+
+memory_sampler::memory_sampler(const std::chrono::milliseconds &interval) :
+	m_stopping(false)
+{
+	last_resident_sample = resident_bytes();
+	m_thread = std::thread([this, interval]() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_stop.wait_for(lock, interval, [this] { return m_stopping; }))
+		{
+			const uint64_t resident = resident_bytes();
+			last_resident_sample = resident;
+			memory_window_registry &registry = window_registry();
+			std::lock_guard<std::mutex> registry_lock(registry.mutex);
+			for (memory_window *window : registry.windows)
+			{
+				window->update_resident(resident);
+			}
+		}
+	});
+}
+
+memory_sampler::~memory_sampler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_stop.notify_all();
+	m_thread.join();
+}
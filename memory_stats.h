@@ -0,0 +1,69 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// How much memory a build holds, and the most it held while a stage ran.
+// Two measures: bytes allocated through the tracked allocator, which is what DevIL allocates image data with, and
+// bytes resident of the whole process, which includes everything else.
+
+// The tracked allocator. DevIL is handed these before it initialises.
+void *tracked_alloc(const size_t &bytes);
+void  tracked_free(const void *pointer);
+
+uint64_t tracked_bytes();
+uint64_t peak_tracked_bytes();
+
+uint64_t resident_bytes();      // Reads from the operating system. Not for hot paths.
+uint64_t peak_resident_bytes(); // High water mark of the process. Cheap.
+
+// Keeps track of the peaks while it exists. Windows can overlap and nest.
+class memory_window
+{
+public:
+	memory_window();
+	~memory_window();
+
+	uint64_t peak_tracked_bytes() const { return m_peak_tracked_bytes; }
+	uint64_t peak_resident_bytes() const;
+	bool     raised_peak_resident_bytes() const; // Whether the process reached a new high while the window was open.
+
+	// Called by the allocator and memory_sampler.
+	void update_tracked(const uint64_t &bytes);
+	void update_resident(const uint64_t &bytes);
+
+private:
+	std::atomic<uint64_t> m_peak_tracked_bytes;
+	std::atomic<uint64_t> m_peak_resident_bytes;
+	uint64_t              m_start_peak_resident_bytes;
+};
+
+// Samples resident bytes into all open memory windows every interval, for as long as it exists. Without it, windows
+// only know the process high water mark.
+class memory_sampler
+{
+public:
+	explicit memory_sampler(const std::chrono::milliseconds &interval);
+	~memory_sampler();
+
+private:
+	std::thread             m_thread;
+	std::mutex              m_mutex;
+	std::condition_variable m_stop;
+	bool                    m_stopping;
+};
+
+#endif // MEMORY_STATS_H
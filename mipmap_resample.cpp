@@ -0,0 +1,162 @@
+#include "mipmap_resample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Which source texels one destination texel covers along one axis, and by how much.
+struct footprint
+{
+	unsigned int       first;
+	std::vector<float> weights; // Sum to one.
+};
+
+static std::vector<footprint> footprints(const unsigned int &source_texels, const unsigned int &destination_texels, const unsigned int &begin, const unsigned int &end)
+{
+	const double scale = (double)source_texels / destination_texels;
+	std::vector<footprint> result(end - begin);
+	for (unsigned int d = begin; d < end; d++)
+	{
+		const double from = d * scale;
+		const double to   = std::min((d + 1) * scale, (double)source_texels);
+		footprint &f = result[d - begin];
+		f.first = (unsigned int)std::floor(from);
+		const unsigned int last = std::min((unsigned int)std::ceil(to), source_texels);
+		for (unsigned int s = f.first; s < last; s++)
+		{
+			const double overlap = std::min(to, s + 1.0) - std::max(from, (double)s);
+			f.weights.push_back((float)(overlap / (to - from)));
+		}
+	}
+	return result;
+}
+
+atlas_rectangle mipmap_region_for(const atlas_rectangle &atlas_region, const unsigned int &atlas_texels_wide, const unsigned int &mipmap_texels_wide)
+{
+	// Destination texel d covers source [d * scale, (d + 1) * scale), so source [a, b) reaches destination [floor(a / scale), ceil(b / scale)).
+	const double scale = (double)atlas_texels_wide / mipmap_texels_wide;
+	const unsigned int begin_x = (unsigned int)std::floor(atlas_region.x / scale);
+	const unsigned int begin_y = (unsigned int)std::floor(atlas_region.y / scale);
+	const unsigned int end_x   = std::min((unsigned int)std::ceil((atlas_region.x + atlas_region.width)  / scale), mipmap_texels_wide);
+	const unsigned int end_y   = std::min((unsigned int)std::ceil((atlas_region.y + atlas_region.height) / scale), mipmap_texels_wide);
+
+	atlas_rectangle mipmap_region;
+	mipmap_region.x      = begin_x;
+	mipmap_region.y      = begin_y;
+	mipmap_region.width  = end_x > begin_x ? end_x - begin_x : 0;
+	mipmap_region.height = end_y > begin_y ? end_y - begin_y : 0;
+	return mipmap_region;
+}
+
+// Converts a filtered value back to a channel.
+template <typename channel_t> static channel_t channel_from_float(const float &value);
+template <> uint8_t channel_from_float<uint8_t>(const float &value)
+{
+	return (uint8_t)std::min(255.0f, std::max(0.0f, value + 0.5f));
+}
+
+// Destination rows resampled at a time. The horizontal pass keeps floats for just the source rows one band needs,
+// rather than for the whole region, which for a full atlas would be several times the atlas itself.
+static const unsigned int band_rows = 64;
+
+// The filter itself, specialised for a channel type and count so the compiler can unroll and vectorise the loops
+// over channels.
+template <typename channel_t, unsigned int channels>
+static void resample_texels(const uint8_t *source_bytes, const unsigned int &source_texels_wide,
+	uint8_t *destination_bytes, const unsigned int &destination_texels_wide,
+	const std::vector<footprint> &columns, const std::vector<footprint> &rows, const unsigned int &begin_x, const unsigned int &begin_y)
+{
+	const channel_t *source      = reinterpret_cast<const channel_t*>(source_bytes);
+	channel_t       *destination = reinterpret_cast<channel_t*>(destination_bytes);
+	const unsigned int region_wide = (unsigned int)columns.size();
+	std::vector<float> horizontal;
+
+	for (size_t band_begin = 0; band_begin < rows.size(); band_begin += band_rows)
+	{
+		const size_t band_end = std::min(band_begin + band_rows, rows.size());
+
+		// Horizontal pass, only over the source rows this band needs. Rows on the edge between bands are done twice.
+		const unsigned int first_source_row = rows[band_begin].first;
+		const unsigned int last_source_row  = rows[band_end - 1].first + (unsigned int)rows[band_end - 1].weights.size();
+		horizontal.assign((size_t)(last_source_row - first_source_row) * region_wide * channels, 0.0f);
+		for (unsigned int source_y = first_source_row; source_y < last_source_row; source_y++)
+		{
+			const channel_t *source_row = source + (size_t)source_y * source_texels_wide * channels;
+			float *horizontal_row = horizontal.data() + (size_t)(source_y - first_source_row) * region_wide * channels;
+			for (unsigned int x = 0; x < region_wide; x++)
+			{
+				const footprint &column = columns[x];
+				float *sum = horizontal_row + (size_t)x * channels;
+				for (size_t i = 0; i < column.weights.size(); i++)
+				{
+					const channel_t *texel = source_row + (size_t)(column.first + i) * channels;
+					for (unsigned int c = 0; c < channels; c++)
+					{
+						sum[c] += column.weights[i] * texel[c];
+					}
+				}
+			}
+		}
+
+		// Vertical pass, straight into the destination.
+		for (size_t y = band_begin; y < band_end; y++)
+		{
+			const footprint &row = rows[y];
+			channel_t *destination_row = destination + (begin_y + y) * destination_texels_wide * channels;
+			for (unsigned int x = 0; x < region_wide; x++)
+			{
+				float sum[channels] = {};
+				for (size_t i = 0; i < row.weights.size(); i++)
+				{
+					const float *texel = horizontal.data() + ((size_t)(row.first + i - first_source_row) * region_wide + x) * channels;
+					for (unsigned int c = 0; c < channels; c++)
+					{
+						sum[c] += row.weights[i] * texel[c];
+					}
+				}
+				channel_t *texel = destination_row + (size_t)(begin_x + x) * channels;
+				for (unsigned int c = 0; c < channels; c++)
+				{
+					texel[c] = channel_from_float<channel_t>(sum[c]);
+				}
+			}
+		}
+	}
+}
+
+typedef void (*resample_kernel)(const uint8_t *source_bytes, const unsigned int &source_texels_wide,
+	uint8_t *destination_bytes, const unsigned int &destination_texels_wide,
+	const std::vector<footprint> &columns, const std::vector<footprint> &rows, const unsigned int &begin_x, const unsigned int &begin_y);
+
+// One entry per supported layout, by channel count. Only 8 bit channels so far.
+static const resample_kernel unsigned_byte_resample_kernels[4] = {
+	&resample_texels<uint8_t, 1>,
+	&resample_texels<uint8_t, 2>,
+	&resample_texels<uint8_t, 3>,
+	&resample_texels<uint8_t, 4>,
+};
+
+void resample_region(const uint8_t *source, const unsigned int &source_texels_wide, const unsigned int &source_texels_high,
+	uint8_t *destination, const unsigned int &destination_texels_wide, const unsigned int &destination_texels_high,
+	const unsigned int &channels, const atlas_rectangle &destination_region)
+{
+	const unsigned int begin_x = std::min(destination_region.x, destination_texels_wide);
+	const unsigned int begin_y = std::min(destination_region.y, destination_texels_high);
+	const unsigned int end_x   = std::min(destination_region.x + destination_region.width,  destination_texels_wide);
+	const unsigned int end_y   = std::min(destination_region.y + destination_region.height, destination_texels_high);
+	if (begin_x >= end_x || begin_y >= end_y || channels < 1 || channels > 4)
+	{
+		return;
+	}
+
+	const std::vector<footprint> columns = footprints(source_texels_wide, destination_texels_wide, begin_x, end_x);
+	const std::vector<footprint> rows    = footprints(source_texels_high, destination_texels_high, begin_y, end_y);
+	unsigned_byte_resample_kernels[channels - 1](source, source_texels_wide, destination, destination_texels_wide, columns, rows, begin_x, begin_y);
+}
+
+size_t resample_scratch_bytes(const unsigned int &source_texels_high, const unsigned int &destination_texels_wide, const unsigned int &destination_texels_high, const unsigned int &channels)
+{
+	// A band of destination rows covers band_rows times the scale in source rows, plus one partly covered row at either end.
+	const unsigned int source_rows = std::min(source_texels_high, (unsigned int)std::ceil((double)band_rows * source_texels_high / std::max(destination_texels_high, 1u)) + 2);
+	return (size_t)source_rows * destination_texels_wide * channels * sizeof(float);
+}
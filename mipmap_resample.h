@@ -0,0 +1,33 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MIPMAP_RESAMPLE_H
+#define MIPMAP_RESAMPLE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "atlas_regions.h"
+
+// Downsampling of the atlas into its mipmap levels with a box filter: every destination texel is the area weighted
+// average of the source texels its footprint covers. Unlike resizing the whole image, any region of the destination
+// can be computed on its own and comes out exactly the same, which is what lets a changed part of the atlas be
+// propagated through the mipmap levels without redoing them entirely.
+
+// Mipmap texels whose footprint overlaps the given atlas rectangle.
+atlas_rectangle mipmap_region_for(const atlas_rectangle &atlas_region, const unsigned int &atlas_texels_wide, const unsigned int &mipmap_texels_wide);
+
+// Resamples destination_region of the destination image from the whole source image. Both images hold 8 bit
+// channels, 1 to 4 of them, row by row from the top.
+void resample_region(const uint8_t *source, const unsigned int &source_texels_wide, const unsigned int &source_texels_high,
+	uint8_t *destination, const unsigned int &destination_texels_wide, const unsigned int &destination_texels_high,
+	const unsigned int &channels, const atlas_rectangle &destination_region);
+
+// Scratch memory resample_region needs at most for a destination of the given size.
+size_t resample_scratch_bytes(const unsigned int &source_texels_high, const unsigned int &destination_texels_wide, const unsigned int &destination_texels_high, const unsigned int &channels);
+
+#endif // MIPMAP_RESAMPLE_H
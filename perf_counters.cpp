@@ -0,0 +1,222 @@
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::atomic<bool> perf_counting(false);
+
+const char *perf_counter_name(const perf_counter &counter)
+{
+	switch (counter)
+	{
+		case perf_cycles:        return "cycles";
+		case perf_instructions:  return "instructions";
+		case perf_cache_misses:  return "cache_misses";
+		case perf_branch_misses: return "branch_misses";
+		default:                 return "";
+	}
+}
+
+perf_counts &perf_counts::operator+=(const perf_counts &other)
+{
+	for (int i = 0; i < perf_counter_count; i++)
+	{
+		values[i] += other.values[i];
+	}
+	counted |= other.counted;
+	return *this;
+}
+
+perf_counts operator-(const perf_counts &end, const perf_counts &start)
+{
+	perf_counts difference;
+	difference.counted = end.counted & start.counted;
+	for (int i = 0; i < perf_counter_count; i++)
+	{
+		difference.values[i] = end.values[i] >= start.values[i] ? end.values[i] - start.values[i] : 0; // Scaled counts can wobble.
+	}
+	return difference;
+}
+
+#if defined(__linux__)
+
+// One group of counters, counting the thread that opened it, in user space only so the default
+// perf_event_paranoid setting allows it.
+class thread_perf_counters
+{
+public:
+	thread_perf_counters() :
+		m_leader(-1),
+		m_error(0)
+	{
+		const uint64_t configs[perf_counter_count] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+		for (int i = 0; i < perf_counter_count; i++)
+		{
+			perf_event_attr attributes;
+			std::memset(&attributes, 0, sizeof(attributes));
+			attributes.type           = PERF_TYPE_HARDWARE;
+			attributes.size           = sizeof(attributes);
+			attributes.config         = configs[i];
+			attributes.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv     = 1;
+			const int fd = (int)syscall(__NR_perf_event_open, &attributes, 0, -1, m_leader, 0); // This thread, any CPU.
+			if (fd < 0)
+			{
+				m_error = m_error ? m_error : errno;
+				continue;
+			}
+			if (m_leader < 0)
+			{
+				m_leader = fd;
+			}
+			m_fds.push_back(fd);
+			m_counters.push_back((perf_counter)i);
+		}
+	}
+
+	~thread_perf_counters()
+	{
+		for (const int &fd : m_fds)
+		{
+			close(fd);
+		}
+	}
+
+	bool read(perf_counts &counts)
+	{
+		if (m_leader < 0)
+		{
+			return false;
+		}
+		struct
+		{
+			uint64_t counters;
+			uint64_t time_enabled;
+			uint64_t time_running;
+			uint64_t values[perf_counter_count];
+		} group;
+		const ssize_t read_bytes = ::read(m_leader, &group, sizeof(group));
+		if (read_bytes < (ssize_t)(3 * sizeof(uint64_t)) || group.counters != m_counters.size())
+		{
+			return false;
+		}
+		// With more counters than the CPU has, the kernel takes turns and counts only part of the time.
+		const double scale = group.time_running > 0 ? (double)group.time_enabled / group.time_running : 0.0;
+		counts = perf_counts();
+		for (size_t i = 0; i < m_counters.size(); i++)
+		{
+			counts.values[m_counters[i]] = (uint64_t)(group.values[i] * scale);
+			counts.counted |= 1u << m_counters[i];
+		}
+		return true;
+	}
+
+	std::string error() const
+	{
+		if (m_fds.size() == perf_counter_count)
+		{
+			return "";
+		}
+		std::string missing;
+		for (int i = 0; i < perf_counter_count; i++)
+		{
+			if (std::find(m_counters.begin(), m_counters.end(), (perf_counter)i) == m_counters.end())
+			{
+				missing += (missing.empty() ? "" : ", ") + std::string(perf_counter_name((perf_counter)i));
+			}
+		}
+		std::string reason = std::strerror(m_error);
+		if (m_error == EACCES || m_error == EPERM)
+		{
+			reason += " (see /proc/sys/kernel/perf_event_paranoid, or the container's seccomp profile)";
+		}
+		else if (m_error == ENOENT || m_error == EOPNOTSUPP || m_error == ENODEV)
+		{
+			reason += " (no such counter on this CPU or virtual machine)";
+		}
+		return "Couldn't open " + missing + ": " + reason;
+	}
+
+	bool any() const { return m_leader >= 0; }
+
+private:
+	int                       m_leader;
+	int                       m_error;
+	std::vector<int>          m_fds;
+	std::vector<perf_counter> m_counters;
+};
+
+static thread_perf_counters &this_thread_perf_counters()
+{
+	thread_local thread_perf_counters counters;
+	return counters;
+}
+
+bool perf_counters_start(std::string &error)
+{
+	thread_perf_counters &counters = this_thread_perf_counters();
+	error = counters.error();
+	if (!counters.any())
+	{
+		return false;
+	}
+	perf_counting = true;
+	return true;
+}
+
+bool read_thread_perf_counts(perf_counts &counts)
+{
+	return this_thread_perf_counters().read(counts);
+}
+
+#else
+
+bool perf_counters_start(std::string &error)
+{
+	error = "Hardware performance counters are only read on Linux";
+	return false;
+}
+
+bool read_thread_perf_counts(perf_counts &counts)
+{
+	return false;
+}
+
+#endif
+
+std::string perf_counts_summary(const perf_counts &counts)
+{
+	std::ostringstream summary;
+	summary.precision(3);
+	for (int i = 0; i < perf_counter_count; i++)
+	{
+		if (counts.counted & (1u << i))
+		{
+			summary << (summary.tellp() > 0 ? ", " : "");
+			if (counts.values[i] >= 1000000)
+			{
+				summary << counts.values[i] / 1e6 << " M ";
+			}
+			else
+			{
+				summary << counts.values[i] << " ";
+			}
+			summary << perf_counter_name((perf_counter)i);
+		}
+	}
+	if ((counts.counted & (1u << perf_cycles)) && (counts.counted & (1u << perf_instructions)) && counts.values[perf_cycles] > 0)
+	{
+		summary << ", " << (double)counts.values[perf_instructions] / counts.values[perf_cycles] << " instructions per cycle";
+	}
+	return summary.str();
+}
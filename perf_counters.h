@@ -0,0 +1,53 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Hardware performance counters of the calling thread, read through perf_event_open on Linux. Every thread gets its
+// own group of counters on first use. Where counters can't be opened, in containers and virtual machines mostly,
+// nothing is counted and everything else carries on as usual. Until counting is started, reading costs one check.
+
+enum perf_counter
+{
+	perf_cycles,
+	perf_instructions,
+	perf_cache_misses,
+	perf_branch_misses,
+	perf_counter_count
+};
+
+const char *perf_counter_name(const perf_counter &counter); // As in the stats JSON: cycles, instructions, cache_misses, branch_misses.
+
+struct perf_counts
+{
+	uint64_t     values[perf_counter_count] = {};
+	unsigned int counted = 0; // Bit per counter that could be read.
+
+	perf_counts &operator+=(const perf_counts &other);
+};
+
+perf_counts operator-(const perf_counts &end, const perf_counts &start);
+
+extern std::atomic<bool> perf_counting;
+inline bool perf_counters_enabled() { return perf_counting.load(std::memory_order_relaxed); }
+
+// Opens the counters of the calling thread and, if at least one could be opened, starts counting on all threads.
+// Otherwise says why not in error. Counters that could be opened but not all are also named in error.
+bool perf_counters_start(std::string &error);
+
+// Counts of the calling thread since its counters were opened. False if it has none.
+bool read_thread_perf_counts(perf_counts &counts);
+
+// One line of what was counted, for the console.
+std::string perf_counts_summary(const perf_counts &counts);
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,174 @@
+#include "subtexture_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+#include "content_hash.h"
+
+struct cache_entry_header
+{
+	char     magic[4] = { 'V', 'T', 'B', 'C' };
+	uint32_t version = 1;
+	uint32_t texels_wide = 0;
+	uint32_t texels_high = 0;
+	uint32_t border_texels_wide = 0;
+	uint32_t bytes_per_texel = 0;
+	uint32_t format = 0;
+	uint32_t type = 0;
+};
+static_assert(sizeof(cache_entry_header) == 32, "Cache entry header is written as is and must not contain padding.");
+
+static const std::string entry_extension = ".vtraw";
+
+subtexture_cache::subtexture_cache(const std::string &directory, const uint64_t &max_bytes) :
+	m_directory(directory),
+	m_max_bytes(max_bytes),
+	m_hits(0),
+	m_misses(0)
+{
+	if (!m_directory.empty())
+	{
+		boost::system::error_code error;
+		boost::filesystem::create_directories(m_directory, error);
+		if (error)
+		{
+			m_directory.clear(); // Without a place to put things there is no cache.
+		}
+	}
+}
+
+uint64_t subtexture_cache::key(const uint64_t &source_hash, const uint32_t &border_texels_wide, const uint32_t &format, const uint32_t &type, const uint32_t &bytes_per_texel)
+{
+	const uint32_t key_fields[5] = { (uint32_t)source_hash, (uint32_t)(source_hash >> 32), border_texels_wide, format, type };
+	return hash_bytes(key_fields, sizeof(key_fields), bytes_per_texel);
+}
+
+std::string subtexture_cache::entry_path(const uint64_t &key) const
+{
+	return (boost::filesystem::path(m_directory) / (hash_to_string(key) + entry_extension)).string();
+}
+
+bool subtexture_cache::load(const uint64_t &key, cached_subtexture &subtexture)
+{
+	if (!enabled())
+	{
+		return false;
+	}
+
+	const std::string path = entry_path(key);
+	std::ifstream file(path, std::ios::binary);
+	cache_entry_header header;
+	if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, "VTBC", 4) != 0 || header.version != 1)
+	{
+		m_misses++;
+		return false;
+	}
+
+	subtexture.texels_wide        = header.texels_wide;
+	subtexture.texels_high        = header.texels_high;
+	subtexture.border_texels_wide = header.border_texels_wide;
+	subtexture.bytes_per_texel    = header.bytes_per_texel;
+	subtexture.format             = header.format;
+	subtexture.type               = header.type;
+	subtexture.texels.resize((size_t)header.texels_wide * header.texels_high * header.bytes_per_texel);
+	if (!file.read(reinterpret_cast<char*>(subtexture.texels.data()), subtexture.texels.size()))
+	{
+		m_misses++;
+		return false;
+	}
+
+	// Touch, so eviction knows this entry is still in use.
+	boost::system::error_code error;
+	boost::filesystem::last_write_time(path, std::time(nullptr), error);
+	m_hits++;
+	return true;
+}
+
+bool subtexture_cache::store(const uint64_t &key, const cached_subtexture &subtexture)
+{
+	if (!enabled())
+	{
+		return false;
+	}
+
+	cache_entry_header header;
+	header.texels_wide        = subtexture.texels_wide;
+	header.texels_high        = subtexture.texels_high;
+	header.border_texels_wide = subtexture.border_texels_wide;
+	header.bytes_per_texel    = subtexture.bytes_per_texel;
+	header.format             = subtexture.format;
+	header.type               = subtexture.type;
+
+	// Write under a unique name first, so other builds never see a half-written entry.
+	const boost::filesystem::path temporary_path = boost::filesystem::path(m_directory) / boost::filesystem::unique_path("%%%%-%%%%-%%%%-%%%%.tmp");
+	{
+		std::ofstream file(temporary_path.string(), std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(subtexture.texels.data()), subtexture.texels.size());
+		if (!file)
+		{
+			boost::system::error_code error;
+			boost::filesystem::remove(temporary_path, error);
+			return false;
+		}
+	}
+
+	boost::system::error_code error;
+	boost::filesystem::rename(temporary_path, entry_path(key), error);
+	if (error)
+	{
+		boost::filesystem::remove(temporary_path, error);
+		return false;
+	}
+	return true;
+}
+
+void subtexture_cache::evict()
+{
+	if (!enabled())
+	{
+		return;
+	}
+
+	struct entry
+	{
+		boost::filesystem::path path;
+		uint64_t                bytes;
+		std::time_t             last_used;
+	};
+	std::vector<entry> entries;
+	uint64_t total_bytes = 0;
+
+	boost::system::error_code error;
+	for (boost::filesystem::directory_iterator i(m_directory, error), end; !error && i != end; i.increment(error))
+	{
+		if (i->path().extension() != entry_extension)
+		{
+			continue;
+		}
+		boost::system::error_code entry_error;
+		const uint64_t    bytes     = boost::filesystem::file_size(i->path(), entry_error);
+		const std::time_t last_used = boost::filesystem::last_write_time(i->path(), entry_error);
+		if (entry_error)
+		{
+			continue; // Probably evicted by another build just now.
+		}
+		entries.push_back({ i->path(), bytes, last_used });
+		total_bytes += bytes;
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const entry &a, const entry &b) { return a.last_used < b.last_used; });
+	for (const entry &oldest : entries)
+	{
+		if (total_bytes <= m_max_bytes)
+		{
+			break;
+		}
+		boost::system::error_code remove_error;
+		boost::filesystem::remove(oldest.path, remove_error);
+		total_bytes -= oldest.bytes;
+	}
+}
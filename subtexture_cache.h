@@ -0,0 +1,59 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SUBTEXTURE_CACHE_H
+#define SUBTEXTURE_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Persistent, content-addressed cache of bordered subtextures, so a source that was bordered before, by any build on
+// this machine, doesn't have to be decoded or bordered again. Entries are raw texels behind a small header, keyed by
+// source content hash, border width and pixel format. Writes go through a temporary file and a rename, so builds can
+// share a cache directory. Least recently used entries are evicted once the cache grows past its size cap.
+
+struct cached_subtexture
+{
+	uint32_t             texels_wide = 0;
+	uint32_t             texels_high = 0;
+	uint32_t             border_texels_wide = 0;
+	uint32_t             bytes_per_texel = 0;
+	uint32_t             format = 0; // DevIL format and type enums, stored as is.
+	uint32_t             type = 0;
+	std::vector<uint8_t> texels;
+};
+
+class subtexture_cache
+{
+public:
+	subtexture_cache(const std::string &directory, const uint64_t &max_bytes);
+
+	bool enabled() const { return !m_directory.empty(); }
+
+	static uint64_t key(const uint64_t &source_hash, const uint32_t &border_texels_wide, const uint32_t &format, const uint32_t &type, const uint32_t &bytes_per_texel);
+
+	// A hit also marks the entry as recently used.
+	bool load(const uint64_t &key, cached_subtexture &subtexture);
+	bool store(const uint64_t &key, const cached_subtexture &subtexture);
+
+	// Removes least recently used entries until the cache fits its size cap.
+	void evict();
+
+	uint64_t hits()   const { return m_hits; }
+	uint64_t misses() const { return m_misses; }
+
+private:
+	std::string entry_path(const uint64_t &key) const;
+
+	std::string m_directory;
+	uint64_t    m_max_bytes;
+	uint64_t    m_hits;
+	uint64_t    m_misses;
+};
+
+#endif // SUBTEXTURE_CACHE_H
@@ -0,0 +1,79 @@
+#include "tile_cache.h"
+
+tile_cache::tile_cache(const size_t &max_bytes) :
+	m_max_bytes(max_bytes),
+	m_bytes(0),
+	m_hits(0),
+	m_misses(0)
+{}
+
+shared_tile tile_cache::find(const uint64_t &key)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const auto found = m_index.find(key);
+	if (found == m_index.end())
+	{
+		m_misses++;
+		return shared_tile();
+	}
+	m_tiles.splice(m_tiles.begin(), m_tiles, found->second);
+	m_hits++;
+	return found->second->second;
+}
+
+shared_tile tile_cache::peek(const uint64_t &key) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const auto found = m_index.find(key);
+	return found == m_index.end() ? shared_tile() : found->second->second;
+}
+
+void tile_cache::insert(const uint64_t &key, const shared_tile &tile)
+{
+	if (!tile || tile->size() > m_max_bytes)
+	{
+		return; // Would only push everything else out.
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const auto found = m_index.find(key);
+	if (found != m_index.end())
+	{
+		m_bytes -= found->second->second->size();
+		m_tiles.erase(found->second);
+	}
+	m_tiles.emplace_front(key, tile);
+	m_index[key] = m_tiles.begin();
+	m_bytes += tile->size();
+
+	while (m_bytes > m_max_bytes)
+	{
+		m_bytes -= m_tiles.back().second->size();
+		m_index.erase(m_tiles.back().first);
+		m_tiles.pop_back();
+	}
+}
+
+uint64_t tile_cache::hits() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_hits;
+}
+
+uint64_t tile_cache::misses() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_misses;
+}
+
+size_t tile_cache::bytes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_bytes;
+}
+
+size_t tile_cache::size() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_tiles.size();
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Encoded tiles kept in memory, at most max_bytes of them. The least recently used tile goes first. Thread-safe.
+// Tiles are shared rather than copied out, so a tile being sent somewhere stays valid if it is evicted meanwhile.
+
+typedef std::shared_ptr<const std::vector<uint8_t>> shared_tile;
+
+class tile_cache
+{
+public:
+	explicit tile_cache(const size_t &max_bytes);
+
+	// Returns an empty pointer if the tile isn't cached.
+	shared_tile find(const uint64_t &key);
+	shared_tile peek(const uint64_t &key) const; // Like find, but doesn't count as a use.
+	void        insert(const uint64_t &key, const shared_tile &tile);
+
+	uint64_t hits() const;
+	uint64_t misses() const;
+	size_t   bytes() const;
+	size_t   size() const;
+
+private:
+	typedef std::list<std::pair<uint64_t, shared_tile>> lru_list; // Most recently used first.
+
+	const size_t                                       m_max_bytes;
+	mutable std::mutex                                 m_mutex;
+	lru_list                                           m_tiles;
+	std::unordered_map<uint64_t, lru_list::iterator>   m_index;
+	size_t                                             m_bytes;
+	uint64_t                                           m_hits;
+	uint64_t                                           m_misses;
+};
+
+#endif // TILE_CACHE_H
@@ -0,0 +1,468 @@
+#include "tile_pack.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "config.h"
+
+#ifdef VT_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef VT_HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+static_assert(sizeof(tile_pack_header) == 64, "Tile pack header is written as is and must not contain padding.");
+static_assert(sizeof(tile_pack_index_entry) == 32, "Tile pack index entries are written as is and must not contain padding.");
+
+// LZ4 only ever looks back 64 KiB, so a bigger dictionary would be dead weight.
+static const size_t lz4_max_dictionary_bytes = 64 * 1024;
+
+bool tile_codec_from_string(const std::string &string, tile_codec &codec)
+{
+	if (string == "raw")  { codec = tile_codec::raw;  return true; }
+	if (string == "lz4")  { codec = tile_codec::lz4;  return true; }
+	if (string == "zstd") { codec = tile_codec::zstd; return true; }
+	return false;
+}
+
+std::string tile_codec_to_string(const tile_codec &codec)
+{
+	switch (codec)
+	{
+	case tile_codec::raw:  return "raw";
+	case tile_codec::lz4:  return "lz4";
+	case tile_codec::zstd: return "zstd";
+	}
+	return "unknown";
+}
+
+bool tile_codec_available(const tile_codec &codec)
+{
+	switch (codec)
+	{
+	case tile_codec::raw:
+		return true;
+	case tile_codec::lz4:
+#ifdef VT_HAVE_LZ4
+		return true;
+#else
+		return false;
+#endif
+	case tile_codec::zstd:
+#ifdef VT_HAVE_ZSTD
+		return true;
+#else
+		return false;
+#endif
+	}
+	return false;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Writer
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct tile_pack_writer::codec_state
+{
+#ifdef VT_HAVE_LZ4
+	LZ4_stream_t *lz4_stream = nullptr;
+	LZ4_stream_t *lz4_dictionary_stream = nullptr; // The dictionary, hashed once.
+#endif
+#ifdef VT_HAVE_ZSTD
+	ZSTD_CCtx    *zstd_context = nullptr;
+	ZSTD_CDict   *zstd_dictionary = nullptr;
+#endif
+
+	~codec_state()
+	{
+#ifdef VT_HAVE_LZ4
+		if (lz4_dictionary_stream) LZ4_freeStream(lz4_dictionary_stream);
+		if (lz4_stream) LZ4_freeStream(lz4_stream);
+#endif
+#ifdef VT_HAVE_ZSTD
+		if (zstd_dictionary) ZSTD_freeCDict(zstd_dictionary);
+		if (zstd_context) ZSTD_freeCCtx(zstd_context);
+#endif
+	}
+};
+
+tile_pack_writer::tile_pack_writer(const std::string &file_path, const tile_codec &codec, const int &codec_level,
+	const unsigned int &tile_texels_wide, const unsigned int &tile_border_texels_wide, const unsigned int &bytes_per_texel,
+	const size_t &dictionary_bytes, const size_t &dictionary_sample_tiles, const unsigned int &layer_count) :
+	m_file(file_path, std::ios::binary | std::ios::trunc),
+	m_dictionary_bytes(codec == tile_codec::raw ? 0 : dictionary_bytes),
+	m_dictionary_sample_tiles(std::max<size_t>(dictionary_sample_tiles, 1)),
+	m_dictionary_done(false),
+	m_codec_state(new codec_state()),
+	m_raw_bytes(0),
+	m_packed_bytes(0),
+	m_closed(false)
+{
+	if (codec == tile_codec::lz4)
+	{
+		m_dictionary_bytes = std::min(m_dictionary_bytes, lz4_max_dictionary_bytes);
+	}
+
+	m_header.codec                   = (uint32_t)codec;
+	m_header.codec_level             = codec_level;
+	m_header.tile_texels_wide        = tile_texels_wide;
+	m_header.tile_border_texels_wide = tile_border_texels_wide;
+	m_header.bytes_per_texel         = bytes_per_texel;
+	m_header.layer_count             = layer_count > 1 ? layer_count : 0; // Single layer packs stay as they always were.
+	m_header.version                 = layer_count > 1 ? 2 : 1;
+	m_header.dictionary_offset       = sizeof(tile_pack_header);
+
+	// Header gets patched on close, once the index offset and tile count are known.
+	m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+
+#ifdef VT_HAVE_LZ4
+	if (codec == tile_codec::lz4) m_codec_state->lz4_stream = LZ4_createStream();
+#endif
+#ifdef VT_HAVE_ZSTD
+	if (codec == tile_codec::zstd) m_codec_state->zstd_context = ZSTD_createCCtx();
+#endif
+
+	// Without a dictionary there is nothing to hold tiles back for.
+	if (m_dictionary_bytes == 0)
+	{
+		m_dictionary_done = true;
+	}
+}
+
+tile_pack_writer::~tile_pack_writer()
+{
+	close();
+}
+
+bool tile_pack_writer::add_tile(const uint32_t &mipID, const uint32_t &x, const uint32_t &y, const uint8_t *data, const size_t &size)
+{
+	if (m_closed || !m_file)
+	{
+		return false;
+	}
+
+	if (!m_dictionary_done)
+	{
+		held_tile tile = { mipID, x, y, std::vector<uint8_t>(data, data + size) };
+		m_held_tiles.push_back(std::move(tile));
+		if (m_held_tiles.size() < m_dictionary_sample_tiles)
+		{
+			return true;
+		}
+		return train_and_write_dictionary();
+	}
+
+	return compress_and_write(mipID, x, y, data, size);
+}
+
+bool tile_pack_writer::train_and_write_dictionary()
+{
+	// Tiles normally come in coarsest mipID first, so the held back tiles together cover the whole atlas. Good sample.
+	// With --tile-usage they come most used first though, so the dictionary is trained on the hottest tiles only. I accept
+	// that skew: those are the tiles read most, so that's where compression pays off. Colder tiles compress a bit worse.
+	if (!m_held_tiles.empty())
+	{
+		std::vector<uint8_t> samples;
+		std::vector<size_t>  sample_sizes;
+		for (const held_tile &tile : m_held_tiles)
+		{
+			samples.insert(samples.end(), tile.data.begin(), tile.data.end());
+			sample_sizes.push_back(tile.data.size());
+		}
+
+		m_dictionary.resize(m_dictionary_bytes);
+#ifdef VT_HAVE_ZSTD
+		const size_t trained_bytes = ZDICT_trainFromBuffer(m_dictionary.data(), m_dictionary.size(), samples.data(), sample_sizes.data(), (unsigned int)sample_sizes.size());
+		if (ZDICT_isError(trained_bytes))
+		{
+			// Training fails if the samples are too few or too uniform. Carry on without a dictionary.
+			m_dictionary.clear();
+		}
+		else
+		{
+			m_dictionary.resize(trained_bytes);
+		}
+#else
+		// No trainer available. Stitch together evenly spaced slices of the samples instead, which still gives LZ4 plenty of matches.
+		const size_t slice_bytes = std::max<size_t>(m_dictionary.size() / m_held_tiles.size(), 1);
+		size_t dictionary_used = 0;
+		for (const held_tile &tile : m_held_tiles)
+		{
+			const size_t copy_bytes = std::min({ slice_bytes, tile.data.size(), m_dictionary.size() - dictionary_used });
+			std::memcpy(m_dictionary.data() + dictionary_used, tile.data.data() + (tile.data.size() - copy_bytes) / 2, copy_bytes);
+			dictionary_used += copy_bytes;
+		}
+		m_dictionary.resize(dictionary_used);
+#endif
+	}
+
+	m_header.dictionary_size = m_dictionary.size();
+	m_file.write(reinterpret_cast<const char*>(m_dictionary.data()), m_dictionary.size());
+
+#ifdef VT_HAVE_LZ4
+	if (m_header.codec == (uint32_t)tile_codec::lz4 && !m_dictionary.empty())
+	{
+		m_codec_state->lz4_dictionary_stream = LZ4_createStream();
+		LZ4_loadDict(m_codec_state->lz4_dictionary_stream, reinterpret_cast<const char*>(m_dictionary.data()), (int)m_dictionary.size());
+	}
+#endif
+#ifdef VT_HAVE_ZSTD
+	if (m_header.codec == (uint32_t)tile_codec::zstd && !m_dictionary.empty())
+	{
+		m_codec_state->zstd_dictionary = ZSTD_createCDict(m_dictionary.data(), m_dictionary.size(), m_header.codec_level);
+	}
+#endif
+	m_dictionary_done = true;
+
+	// Now compress everything that was held back.
+	bool success = true;
+	for (const held_tile &tile : m_held_tiles)
+	{
+		success = compress_and_write(tile.mipID, tile.x, tile.y, tile.data.data(), tile.data.size()) && success;
+	}
+	m_held_tiles.clear();
+	m_held_tiles.shrink_to_fit();
+	return success;
+}
+
+bool tile_pack_writer::compress_and_write(const uint32_t &mipID, const uint32_t &x, const uint32_t &y, const uint8_t *data, const size_t &size)
+{
+	const char *blob = reinterpret_cast<const char*>(data);
+	size_t blob_size = size;
+
+	switch ((tile_codec)m_header.codec)
+	{
+	case tile_codec::raw:
+		break;
+	case tile_codec::lz4:
+	{
+#ifdef VT_HAVE_LZ4
+		m_compress_buffer.resize(LZ4_compressBound((int)size));
+		// Starting from the dictionary hashed once is much cheaper than hashing it again for every tile.
+#if LZ4_VERSION_NUMBER >= 11000
+		LZ4_resetStream_fast(m_codec_state->lz4_stream);
+		LZ4_attach_dictionary(m_codec_state->lz4_stream, m_codec_state->lz4_dictionary_stream);
+#else
+		// LZ4_attach_dictionary is only exported from 1.10 on. Copying the hashed stream does the same.
+		if (m_codec_state->lz4_dictionary_stream)
+		{
+			*m_codec_state->lz4_stream = *m_codec_state->lz4_dictionary_stream;
+		}
+		else
+		{
+			LZ4_resetStream(m_codec_state->lz4_stream);
+		}
+#endif
+		const int compressed = LZ4_compress_fast_continue(m_codec_state->lz4_stream, blob, reinterpret_cast<char*>(m_compress_buffer.data()), (int)size, (int)m_compress_buffer.size(), std::max(m_header.codec_level, 1));
+		if (compressed <= 0)
+		{
+			return false;
+		}
+		blob = reinterpret_cast<const char*>(m_compress_buffer.data());
+		blob_size = (size_t)compressed;
+		break;
+#else
+		return false;
+#endif
+	}
+	case tile_codec::zstd:
+	{
+#ifdef VT_HAVE_ZSTD
+		m_compress_buffer.resize(ZSTD_compressBound(size));
+		const size_t compressed = m_codec_state->zstd_dictionary
+			? ZSTD_compress_usingCDict(m_codec_state->zstd_context, m_compress_buffer.data(), m_compress_buffer.size(), data, size, m_codec_state->zstd_dictionary)
+			: ZSTD_compressCCtx(m_codec_state->zstd_context, m_compress_buffer.data(), m_compress_buffer.size(), data, size, m_header.codec_level);
+		if (ZSTD_isError(compressed))
+		{
+			return false;
+		}
+		blob = reinterpret_cast<const char*>(m_compress_buffer.data());
+		blob_size = compressed;
+		break;
+#else
+		return false;
+#endif
+	}
+	default:
+		return false;
+	}
+
+	tile_pack_index_entry entry = { mipID, x, y, (uint32_t)size, (uint64_t)m_file.tellp(), (uint64_t)blob_size };
+	m_file.write(blob, blob_size);
+	if (!m_file)
+	{
+		return false;
+	}
+	m_index.push_back(entry);
+	m_raw_bytes    += size;
+	m_packed_bytes += blob_size;
+	return true;
+}
+
+bool tile_pack_writer::close()
+{
+	if (m_closed)
+	{
+		return true;
+	}
+
+	// Fewer tiles than requested samples: train on what we've got.
+	bool success = m_dictionary_done || train_and_write_dictionary();
+	m_closed = true;
+
+	m_header.index_offset = (uint64_t)m_file.tellp();
+	m_header.tile_count   = m_index.size();
+	m_file.write(reinterpret_cast<const char*>(m_index.data()), m_index.size() * sizeof(tile_pack_index_entry));
+
+	m_file.seekp(0);
+	m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+	success = success && (bool)m_file;
+	m_file.close();
+	return success;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reader
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct tile_pack_reader::codec_state
+{
+#ifdef VT_HAVE_ZSTD
+	ZSTD_DCtx  *zstd_context = nullptr;
+	ZSTD_DDict *zstd_dictionary = nullptr;
+#endif
+
+	~codec_state()
+	{
+#ifdef VT_HAVE_ZSTD
+		if (zstd_dictionary) ZSTD_freeDDict(zstd_dictionary);
+		if (zstd_context) ZSTD_freeDCtx(zstd_context);
+#endif
+	}
+};
+
+tile_pack_reader::tile_pack_reader()
+{}
+
+tile_pack_reader::~tile_pack_reader()
+{}
+
+bool tile_pack_reader::open(const std::string &file_path)
+{
+	m_file.open(file_path, std::ios::binary);
+	if (!m_file)
+	{
+		return false;
+	}
+
+	m_file.read(reinterpret_cast<char*>(&m_header), sizeof(m_header));
+	if (!m_file || std::memcmp(m_header.magic, "VTTP", 4) != 0 || (m_header.version != 1 && m_header.version != 2))
+	{
+		return false;
+	}
+	if (!tile_codec_available((tile_codec)m_header.codec))
+	{
+		return false;
+	}
+
+	m_dictionary.resize((size_t)m_header.dictionary_size);
+	m_file.seekg((std::streamoff)m_header.dictionary_offset);
+	m_file.read(reinterpret_cast<char*>(m_dictionary.data()), m_dictionary.size());
+
+	std::vector<tile_pack_index_entry> entries((size_t)m_header.tile_count);
+	m_file.seekg((std::streamoff)m_header.index_offset);
+	m_file.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(tile_pack_index_entry));
+	if (!m_file)
+	{
+		return false;
+	}
+	m_index.reserve(entries.size());
+	for (const tile_pack_index_entry &entry : entries)
+	{
+		m_index[tile_pack_key(entry.mipID, entry.x, entry.y)] = entry;
+	}
+
+	// Decoder state and dictionary are prepared once, so each tile only pays for the actual decode.
+	m_codec_state.reset(new codec_state());
+#ifdef VT_HAVE_ZSTD
+	if (m_header.codec == (uint32_t)tile_codec::zstd)
+	{
+		m_codec_state->zstd_context = ZSTD_createDCtx();
+		if (!m_dictionary.empty())
+		{
+			m_codec_state->zstd_dictionary = ZSTD_createDDict(m_dictionary.data(), m_dictionary.size());
+		}
+	}
+#endif
+	return true;
+}
+
+bool tile_pack_reader::has_tile(const uint32_t &mipID, const uint32_t &x, const uint32_t &y) const
+{
+	return m_index.count(tile_pack_key(mipID, x, y)) > 0;
+}
+
+bool tile_pack_reader::read_blob(const uint32_t &mipID, const uint32_t &x, const uint32_t &y, std::vector<uint8_t> &blob, uint32_t &raw_size)
+{
+	const auto found = m_index.find(tile_pack_key(mipID, x, y));
+	if (found == m_index.end())
+	{
+		return false;
+	}
+	const tile_pack_index_entry &entry = found->second;
+
+	blob.resize((size_t)entry.compressed_size);
+	m_file.clear();
+	m_file.seekg((std::streamoff)entry.offset);
+	m_file.read(reinterpret_cast<char*>(blob.data()), blob.size());
+	raw_size = entry.raw_size;
+	return (bool)m_file;
+}
+
+bool tile_pack_reader::read_tile(const uint32_t &mipID, const uint32_t &x, const uint32_t &y, std::vector<uint8_t> &texels)
+{
+	uint32_t raw_size = 0;
+	if (!read_blob(mipID, x, y, m_blob_buffer, raw_size))
+	{
+		return false;
+	}
+	texels.resize(raw_size);
+
+	switch ((tile_codec)m_header.codec)
+	{
+	case tile_codec::raw:
+		if (m_blob_buffer.size() != raw_size)
+		{
+			return false;
+		}
+		std::memcpy(texels.data(), m_blob_buffer.data(), raw_size);
+		return true;
+	case tile_codec::lz4:
+	{
+#ifdef VT_HAVE_LZ4
+		const int decompressed = m_dictionary.empty()
+			? LZ4_decompress_safe(reinterpret_cast<const char*>(m_blob_buffer.data()), reinterpret_cast<char*>(texels.data()), (int)m_blob_buffer.size(), (int)raw_size)
+			: LZ4_decompress_safe_usingDict(reinterpret_cast<const char*>(m_blob_buffer.data()), reinterpret_cast<char*>(texels.data()), (int)m_blob_buffer.size(), (int)raw_size, reinterpret_cast<const char*>(m_dictionary.data()), (int)m_dictionary.size());
+		return decompressed == (int)raw_size;
+#else
+		return false;
+#endif
+	}
+	case tile_codec::zstd:
+	{
+#ifdef VT_HAVE_ZSTD
+		const size_t decompressed = m_codec_state->zstd_dictionary
+			? ZSTD_decompress_usingDDict(m_codec_state->zstd_context, texels.data(), raw_size, m_blob_buffer.data(), m_blob_buffer.size(), m_codec_state->zstd_dictionary)
+			: ZSTD_decompressDCtx(m_codec_state->zstd_context, texels.data(), raw_size, m_blob_buffer.data(), m_blob_buffer.size());
+		return !ZSTD_isError(decompressed) && decompressed == raw_size;
+#else
+		return false;
+#endif
+	}
+	}
+	return false;
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TILE_PACK_H
+#define TILE_PACK_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A tile pack is a single container file holding every tile of a run as an independently compressed blob.
+// Tiles from one atlas look very much alike, so the codec can optionally use a dictionary trained on a sample
+// of this run's tiles. That dictionary is stored right behind the header, the blobs follow, and an index
+// at the end of the file maps (mipID, x, y) to a blob. Any tile can thus be read with one seek and one read.
+//
+// File layout (all integers little-endian):
+//   header     (tile_pack_header, fixed size)
+//   dictionary (header.dictionary_size bytes, may be empty)
+//   blobs      (one per tile)
+//   index      (header.tile_count times tile_pack_index_entry)
+//
+// A pack of several material layers can hold them interleaved: each blob then decodes to the same tile of every
+// layer back to back, layer l starting at tile_pack_layer_offset(header, l). A page of all layers takes one read
+// and one decode. Such packs are version 2, so readers that only know one layer per blob refuse them.
+
+enum class tile_codec : uint32_t
+{
+	raw  = 0, // Uncompressed texel bytes.
+	lz4  = 1, // Fast decode.
+	zstd = 2, // Better ratio.
+};
+
+bool        tile_codec_from_string(const std::string &string, tile_codec &codec);
+std::string tile_codec_to_string(const tile_codec &codec);
+bool        tile_codec_available(const tile_codec &codec); // Whether this build was linked against the codec's library.
+
+struct tile_pack_header
+{
+	char     magic[4] = { 'V', 'T', 'T', 'P' };
+	uint32_t version = 1;
+	uint32_t codec = 0;
+	int32_t  codec_level = 0;
+	uint32_t tile_texels_wide = 0;
+	uint32_t tile_border_texels_wide = 0;
+	uint32_t bytes_per_texel = 0;
+	uint32_t layer_count = 0; // Interleaved layers per blob in version 2 packs. 0 in version 1 packs, meaning 1.
+	uint64_t dictionary_offset = 0;
+	uint64_t dictionary_size = 0;
+	uint64_t index_offset = 0;
+	uint64_t tile_count = 0;
+};
+
+struct tile_pack_index_entry
+{
+	uint32_t mipID;
+	uint32_t x;
+	uint32_t y;
+	uint32_t raw_size;
+	uint64_t offset;
+	uint64_t compressed_size;
+};
+
+inline uint32_t tile_pack_layer_count(const tile_pack_header &header)
+{
+	return header.layer_count > 1 ? header.layer_count : 1;
+}
+
+// Where a layer starts within a decoded blob. All layers have the same size.
+inline size_t tile_pack_layer_offset(const tile_pack_header &header, const uint32_t &layer)
+{
+	return (size_t)layer * header.tile_texels_wide * header.tile_texels_wide * header.bytes_per_texel;
+}
+
+inline uint64_t tile_pack_key(const uint32_t &mipID, const uint32_t &x, const uint32_t &y)
+{
+	// 16 bits is plenty for a mipID, leaving 24 bits per coordinate (16M tiles wide).
+	return ((uint64_t)mipID << 48) | ((uint64_t)(x & 0xFFFFFF) << 24) | (uint64_t)(y & 0xFFFFFF);
+}
+
+class tile_pack_writer
+{
+public:
+	// dictionary_bytes of 0 disables the dictionary. Otherwise the first dictionary_sample_tiles tiles are
+	// held back, a dictionary is trained on them, and only then anything is compressed. So which tiles the
+	// dictionary fits best depends on the order they're added in.
+	// With more than one layer, each tile added holds all layers back to back.
+	tile_pack_writer(const std::string &file_path, const tile_codec &codec, const int &codec_level,
+		const unsigned int &tile_texels_wide, const unsigned int &tile_border_texels_wide, const unsigned int &bytes_per_texel,
+		const size_t &dictionary_bytes, const size_t &dictionary_sample_tiles, const unsigned int &layer_count = 1);
+	~tile_pack_writer();
+
+	bool is_open() const { return m_file.is_open(); }
+
+	bool add_tile(const uint32_t &mipID, const uint32_t &x, const uint32_t &y, const uint8_t *data, const size_t &size);
+
+	// Flushes held back tiles, writes the index and patches the header. Called by the destructor if need be.
+	bool close();
+
+	uint64_t tiles_written() const { return m_index.size(); }
+	uint64_t raw_bytes()     const { return m_raw_bytes; }
+	uint64_t packed_bytes()  const { return m_packed_bytes; }
+	uint64_t dictionary_size() const { return m_header.dictionary_size; }
+
+private:
+	struct held_tile
+	{
+		uint32_t mipID;
+		uint32_t x;
+		uint32_t y;
+		std::vector<uint8_t> data;
+	};
+	struct codec_state;
+
+	bool train_and_write_dictionary();
+	bool compress_and_write(const uint32_t &mipID, const uint32_t &x, const uint32_t &y, const uint8_t *data, const size_t &size);
+
+	std::ofstream                      m_file;
+	tile_pack_header                   m_header;
+	size_t                             m_dictionary_bytes;
+	size_t                             m_dictionary_sample_tiles;
+	bool                               m_dictionary_done;
+	std::vector<uint8_t>               m_dictionary;
+	std::vector<held_tile>             m_held_tiles;
+	std::vector<tile_pack_index_entry> m_index;
+	std::vector<uint8_t>               m_compress_buffer;
+	std::unique_ptr<codec_state>       m_codec_state;
+	uint64_t                           m_raw_bytes;
+	uint64_t                           m_packed_bytes;
+	bool                               m_closed;
+};
+
+// Not thread-safe. Open one reader per thread for concurrent access; the index and dictionary are small.
+class tile_pack_reader
+{
+public:
+	tile_pack_reader();
+	~tile_pack_reader();
+
+	bool open(const std::string &file_path);
+
+	const tile_pack_header &header() const { return m_header; }
+	bool has_tile(const uint32_t &mipID, const uint32_t &x, const uint32_t &y) const;
+
+	// Reads and decodes one tile into texels, of all layers if interleaved. Returns false if the tile is absent or corrupt.
+	bool read_tile(const uint32_t &mipID, const uint32_t &x, const uint32_t &y, std::vector<uint8_t> &texels);
+
+	// Reads the blob as stored, without decoding. Useful for serving tiles to a client that decodes itself.
+	bool read_blob(const uint32_t &mipID, const uint32_t &x, const uint32_t &y, std::vector<uint8_t> &blob, uint32_t &raw_size);
+
+private:
+	struct codec_state;
+
+	std::ifstream                                       m_file;
+	tile_pack_header                                    m_header;
+	std::vector<uint8_t>                                m_dictionary;
+	std::unordered_map<uint64_t, tile_pack_index_entry> m_index;
+	std::vector<uint8_t>                                m_blob_buffer;
+	std::unique_ptr<codec_state>                        m_codec_state;
+};
+
+#endif // TILE_PACK_H
@@ -0,0 +1,104 @@
+#include "tile_path.h"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+
+static const char separator = (char)boost::filesystem::path::preferred_separator;
+
+bool tile_layout_from_string(const std::string &string, tile_layout &layout)
+{
+	if (string == "flat")    { layout = tile_layout::flat;    return true; }
+	if (string == "sharded") { layout = tile_layout::sharded; return true; }
+	return false;
+}
+
+std::string tile_layout_to_string(const tile_layout &layout)
+{
+	switch (layout)
+	{
+	case tile_layout::flat:    return "flat";
+	case tile_layout::sharded: return "sharded";
+	}
+	return "unknown";
+}
+
+tile_path_builder::tile_path_builder(const std::string &tiles_folder, const tile_layout &layout, const unsigned int &fan_out, const std::string &file_extension) :
+	m_tiles_folder(tiles_folder),
+	m_layout(layout),
+	m_fan_out(std::max(fan_out, 1u)),
+	m_file_extension(file_extension)
+{
+	// Folder, two shard levels, the file name with three numbers and the extension. Ten digits per number is plenty.
+	m_path.reserve(m_tiles_folder.size() + 2 * (1 + 10) + 1 + 32 + 3 * 10 + m_file_extension.size());
+}
+
+void tile_path_builder::append_number(unsigned int number)
+{
+	char digits[10];
+	int count = 0;
+	do
+	{
+		digits[count++] = (char)('0' + number % 10);
+		number /= 10;
+	} while (number > 0);
+	while (count > 0)
+	{
+		m_path.push_back(digits[--count]);
+	}
+}
+
+const std::string &tile_path_builder::path(const unsigned int &mipID, const unsigned int &x, const unsigned int &y)
+{
+	m_path.assign(m_tiles_folder);
+	m_path.push_back(separator);
+	if (m_layout == tile_layout::sharded)
+	{
+		append_number(mipID);
+		m_path.push_back(separator);
+		append_number(x / m_fan_out);
+		m_path.push_back(separator);
+	}
+	m_path.append("tile_mipid_");
+	append_number(mipID);
+	m_path.append("_x_");
+	append_number(x);
+	m_path.append("_y_");
+	append_number(y);
+	m_path.append(m_file_extension);
+	return m_path;
+}
+
+bool tile_path_builder::create_directories(const unsigned int &max_mipID) const
+{
+	if (m_layout == tile_layout::flat)
+	{
+		return true;
+	}
+
+	boost::system::error_code error;
+	for (unsigned int mipID = 0; mipID <= max_mipID; mipID++)
+	{
+		const unsigned int tiles_wide = 1u << mipID;
+		const unsigned int buckets    = (tiles_wide + m_fan_out - 1) / m_fan_out;
+		for (unsigned int bucket = 0; bucket < buckets; bucket++)
+		{
+			const boost::filesystem::path directory = boost::filesystem::path(m_tiles_folder) / std::to_string(mipID) / std::to_string(bucket);
+			boost::filesystem::create_directories(directory, error);
+			if (error)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+std::string tile_path_builder::pattern() const
+{
+	const std::string file_name = "tile_mipid_{mipID}_x_{x}_y_{y}" + m_file_extension;
+	if (m_layout == tile_layout::sharded)
+	{
+		return "{mipID}/{x_bucket}/" + file_name;
+	}
+	return file_name;
+}
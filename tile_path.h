@@ -0,0 +1,54 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TILE_PATH_H
+#define TILE_PATH_H
+
+#include <string>
+
+// Where loose tile files go.
+//   flat    - <tiles folder>/tile_mipid_<mipID>_x_<x>_y_<y><ext>
+//   sharded - <tiles folder>/<mipID>/<x / fan_out>/tile_mipid_<mipID>_x_<x>_y_<y><ext>
+// Sharding keeps directories small, which matters for lookups and for ls and rsync once there are many tiles.
+// The layout and fan-out are recorded in tile_info.xml so readers can build paths without scanning directories.
+enum class tile_layout
+{
+	flat,
+	sharded,
+};
+
+bool        tile_layout_from_string(const std::string &string, tile_layout &layout);
+std::string tile_layout_to_string(const tile_layout &layout);
+
+class tile_path_builder
+{
+public:
+	tile_path_builder(const std::string &tiles_folder, const tile_layout &layout, const unsigned int &fan_out, const std::string &file_extension);
+
+	// Formats into a buffer that is allocated once and reused. The reference stays valid until the next call.
+	const std::string &path(const unsigned int &mipID, const unsigned int &x, const unsigned int &y);
+
+	// Creates all shard directories for mipIDs up to and including max_mipID, so no tile has to check for its directory.
+	bool create_directories(const unsigned int &max_mipID) const;
+
+	tile_layout  layout()  const { return m_layout; }
+	unsigned int fan_out() const { return m_fan_out; }
+
+	// Path of a tile relative to the tiles folder, with placeholders. Recorded in tile_info.xml.
+	std::string pattern() const;
+
+private:
+	void append_number(unsigned int number);
+
+	const std::string  m_tiles_folder;
+	const tile_layout  m_layout;
+	const unsigned int m_fan_out;
+	const std::string  m_file_extension;
+	std::string        m_path;
+};
+
+#endif // TILE_PATH_H
@@ -0,0 +1,359 @@
+#include "tile_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <boost/asio.hpp>
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "tile_cache.h"
+#include "tile_pack.h" // tile_pack_key
+
+std::string content_type_for_extension(const std::string &file_extension)
+{
+	std::string extension = file_extension;
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	if (extension == ".png")                          return "image/png";
+	if (extension == ".jpg" || extension == ".jpeg")  return "image/jpeg";
+	if (extension == ".bmp")                          return "image/bmp";
+	if (extension == ".tga")                          return "image/x-tga";
+	if (extension == ".dds")                          return "image/vnd-ms.dds";
+	return "application/octet-stream";
+}
+
+struct tile_server_state
+{
+	tile_server_state(const tile_generator &generator, const unsigned int &levels, const std::string &content_type, const size_t &cache_bytes) :
+		generator(generator),
+		levels(levels),
+		content_type(content_type),
+		cache(cache_bytes),
+		requests(0),
+		tiles_generated(0),
+		tiles_not_found(0),
+		signals(io_context, SIGINT, SIGTERM)
+	{}
+
+	tile_generator          generator;
+	std::mutex              generator_mutex;
+	unsigned int            levels;
+	std::string             content_type;
+	tile_cache              cache;
+	std::atomic<uint64_t>   requests;
+	std::atomic<uint64_t>   tiles_generated;
+	std::atomic<uint64_t>   tiles_not_found;
+
+	boost::asio::io_context                         io_context;
+	boost::asio::signal_set                         signals;
+	std::unique_ptr<boost::asio::ip::tcp::acceptor> tcp_acceptor;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	std::unique_ptr<boost::asio::local::stream_protocol::acceptor> local_acceptor;
+	std::string                                                    socket_path;
+#endif
+};
+
+struct tile_response
+{
+	unsigned int status;
+	std::string  reason;
+	std::string  content_type;
+	shared_tile  body;
+};
+
+static tile_response text_response(const unsigned int &status, const std::string &reason, const std::string &content_type, const std::string &text)
+{
+	return { status, reason, content_type, std::make_shared<const std::vector<uint8_t>>(text.begin(), text.end()) };
+}
+
+static tile_response respond(tile_server_state &state, const std::string &method, const std::string &target)
+{
+	state.requests++;
+	if (method != "GET")
+	{
+		return text_response(405, "Method Not Allowed", "text/plain", "Only GET is supported.\n");
+	}
+
+	unsigned int mipID, x, y;
+	char trailing;
+	if (std::sscanf(target.c_str(), "/tiles/%u/%u/%u%c", &mipID, &x, &y, &trailing) == 3)
+	{
+		// Out of range coordinates would wrap around in the cache key and hit some other tile, so they never get that far.
+		// tile_pack_key holds 24 bits per coordinate, so no level can be more than 2^24 tiles wide either way.
+		if (mipID >= state.levels || mipID >= 25 || x >= (1u << mipID) || y >= (1u << mipID))
+		{
+			state.tiles_not_found++;
+			return text_response(404, "Not Found", "text/plain", "No such tile.\n");
+		}
+		const uint64_t key = tile_pack_key(mipID, x, y);
+		shared_tile tile = state.cache.find(key);
+		if (!tile)
+		{
+			std::lock_guard<std::mutex> lock(state.generator_mutex);
+			tile = state.cache.peek(key); // Whoever held the lock before may have been generating this very tile.
+			if (!tile)
+			{
+				std::shared_ptr<std::vector<uint8_t>> encoded = std::make_shared<std::vector<uint8_t>>();
+				if (!state.generator(mipID, x, y, *encoded))
+				{
+					state.tiles_not_found++;
+					return text_response(404, "Not Found", "text/plain", "No such tile.\n");
+				}
+				state.tiles_generated++;
+				tile = encoded;
+				state.cache.insert(key, tile);
+			}
+		}
+		return { 200, "OK", state.content_type, tile };
+	}
+
+	if (target == "/stats")
+	{
+		std::ostringstream json;
+		json << "{\"requests\": " << state.requests
+			<< ", \"tiles_generated\": " << state.tiles_generated
+			<< ", \"tiles_not_found\": " << state.tiles_not_found
+			<< ", \"cache_hits\": " << state.cache.hits()
+			<< ", \"cache_misses\": " << state.cache.misses()
+			<< ", \"cache_bytes\": " << state.cache.bytes()
+			<< ", \"cached_tiles\": " << state.cache.size() << "}\n";
+		return text_response(200, "OK", "application/json", json.str());
+	}
+
+	return text_response(404, "Not Found", "text/plain", "Request /tiles/<mipID>/<x>/<y> or /stats.\n");
+}
+
+// One client connection, TCP or Unix domain socket. Keeps itself alive through the handlers it has pending.
+template <typename Protocol>
+class tile_connection : public std::enable_shared_from_this<tile_connection<Protocol>>
+{
+public:
+	tile_connection(typename Protocol::socket socket, tile_server_state &state) :
+		m_socket(std::move(socket)),
+		m_state(state)
+	{}
+
+	void read_request()
+	{
+		auto self = this->shared_from_this();
+		boost::asio::async_read_until(m_socket, m_buffer, "\r\n\r\n", [this, self](const boost::system::error_code &error, const std::size_t &) {
+			if (error)
+			{
+				return; // Most likely the client hung up.
+			}
+
+			std::istream request(&m_buffer);
+			std::string method, target, version, line;
+			request >> method >> target >> version;
+			std::getline(request, line);
+			bool keep_alive = version == "HTTP/1.1";
+			while (std::getline(request, line) && line != "\r")
+			{
+				std::transform(line.begin(), line.end(), line.begin(), ::tolower);
+				if (line.compare(0, 11, "connection:") == 0)
+				{
+					keep_alive = line.find("close") == std::string::npos;
+				}
+			}
+			write_response(respond(m_state, method, target), keep_alive);
+		});
+	}
+
+private:
+	void write_response(const tile_response &response, const bool &keep_alive)
+	{
+		m_response = response;
+		std::ostringstream header;
+		header << "HTTP/1.1 " << response.status << " " << response.reason << "\r\n"
+			<< "Content-Type: " << response.content_type << "\r\n"
+			<< "Content-Length: " << response.body->size() << "\r\n"
+			<< (keep_alive ? "" : "Connection: close\r\n")
+			<< "\r\n";
+		m_header = header.str();
+
+		const std::vector<boost::asio::const_buffer> buffers = { boost::asio::buffer(m_header), boost::asio::buffer(*m_response.body) };
+		auto self = this->shared_from_this();
+		boost::asio::async_write(m_socket, buffers, [this, self, keep_alive](const boost::system::error_code &error, const std::size_t &) {
+			if (error)
+			{
+				return;
+			}
+			if (keep_alive)
+			{
+				read_request();
+				return;
+			}
+			boost::system::error_code ignored;
+			m_socket.shutdown(Protocol::socket::shutdown_both, ignored);
+		});
+	}
+
+	typename Protocol::socket m_socket;
+	tile_server_state        &m_state;
+	boost::asio::streambuf    m_buffer;
+	std::string               m_header;
+	tile_response             m_response;
+};
+
+template <typename Protocol>
+static void accept_connections(typename Protocol::acceptor &acceptor, tile_server_state &state)
+{
+	acceptor.async_accept([&acceptor, &state](const boost::system::error_code &error, typename Protocol::socket socket) {
+		if (!acceptor.is_open())
+		{
+			return; // Stopped.
+		}
+		if (!error)
+		{
+			std::make_shared<tile_connection<Protocol>>(std::move(socket), state)->read_request();
+		}
+		accept_connections<Protocol>(acceptor, state);
+	});
+}
+
+tile_server::tile_server(const tile_generator &generator, const unsigned int &levels, const std::string &content_type, const size_t &cache_bytes, const unsigned int &threads) :
+	m_state(new tile_server_state(generator, levels, content_type, cache_bytes)),
+	m_threads(std::max(threads, 1u))
+{}
+
+tile_server::~tile_server()
+{
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+	if (!m_state->socket_path.empty())
+	{
+		::unlink(m_state->socket_path.c_str());
+	}
+#endif
+}
+
+bool tile_server::listen(const std::string &endpoint)
+{
+	boost::system::error_code error;
+	if (endpoint.compare(0, 5, "unix:") == 0)
+	{
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+		const std::string socket_path = endpoint.substr(5);
+
+		// A socket left behind by a server that didn't get to clean up would be in the way. Anything else at that path is left alone.
+		struct stat existing;
+		if (::stat(socket_path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+		{
+			::unlink(socket_path.c_str());
+		}
+
+		typedef boost::asio::local::stream_protocol local;
+		m_state->local_acceptor.reset(new local::acceptor(m_state->io_context));
+		m_state->local_acceptor->open(local(), error);
+		if (!error) m_state->local_acceptor->bind(local::endpoint(socket_path), error);
+		if (!error) m_state->local_acceptor->listen(boost::asio::socket_base::max_listen_connections, error);
+		if (error)
+		{
+			m_error = error.message();
+			return false;
+		}
+		m_state->socket_path = socket_path;
+		accept_connections<local>(*m_state->local_acceptor, *m_state);
+		return true;
+#else
+		m_error = "Unix domain sockets aren't supported on this platform";
+		return false;
+#endif
+	}
+
+	std::string address = "127.0.0.1";
+	std::string port    = endpoint;
+	const size_t colon = endpoint.rfind(':');
+	if (colon != std::string::npos)
+	{
+		address = endpoint.substr(0, colon);
+		port    = endpoint.substr(colon + 1);
+	}
+	char *port_end = nullptr;
+	const unsigned long port_number = std::strtoul(port.c_str(), &port_end, 10);
+	if (port.empty() || *port_end != '\0' || port_number > 65535)
+	{
+		m_error = "Invalid port " + port;
+		return false;
+	}
+	const boost::asio::ip::address ip = boost::asio::ip::make_address(address, error);
+	if (error)
+	{
+		m_error = "Invalid address " + address;
+		return false;
+	}
+
+	typedef boost::asio::ip::tcp tcp;
+	const tcp::endpoint tcp_endpoint(ip, (unsigned short)port_number);
+	m_state->tcp_acceptor.reset(new tcp::acceptor(m_state->io_context));
+	m_state->tcp_acceptor->open(tcp_endpoint.protocol(), error);
+	if (!error) m_state->tcp_acceptor->set_option(tcp::acceptor::reuse_address(true), error);
+	if (!error) m_state->tcp_acceptor->bind(tcp_endpoint, error);
+	if (!error) m_state->tcp_acceptor->listen(boost::asio::socket_base::max_listen_connections, error);
+	if (error)
+	{
+		m_error = error.message();
+		return false;
+	}
+	accept_connections<tcp>(*m_state->tcp_acceptor, *m_state);
+	return true;
+}
+
+void tile_server::run()
+{
+	m_state->signals.async_wait([this](const boost::system::error_code &error, const int &) {
+		if (!error)
+		{
+			stop();
+		}
+	});
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 1; i < m_threads; i++)
+	{
+		threads.emplace_back([this]() { m_state->io_context.run(); });
+	}
+	m_state->io_context.run();
+	for (std::thread &thread : threads)
+	{
+		thread.join();
+	}
+}
+
+void tile_server::stop()
+{
+	boost::asio::post(m_state->io_context, [this]() {
+		boost::system::error_code ignored;
+		if (m_state->tcp_acceptor)
+		{
+			m_state->tcp_acceptor->close(ignored);
+		}
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+		if (m_state->local_acceptor)
+		{
+			m_state->local_acceptor->close(ignored);
+		}
+#endif
+		m_state->signals.cancel(ignored);
+		m_state->io_context.stop();
+	});
+}
+
+tile_server_stats tile_server::stats() const
+{
+	tile_server_stats stats;
+	stats.requests        = m_state->requests;
+	stats.tiles_generated = m_state->tiles_generated;
+	stats.tiles_not_found = m_state->tiles_not_found;
+	stats.cache_hits      = m_state->cache.hits();
+	stats.cache_misses    = m_state->cache.misses();
+	stats.cache_bytes     = m_state->cache.bytes();
+	stats.cached_tiles    = m_state->cache.size();
+	return stats;
+}
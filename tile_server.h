@@ -0,0 +1,68 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef TILE_SERVER_H
+#define TILE_SERVER_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Serves tiles over HTTP/1.1, on localhost or a Unix domain socket, instead of writing them all up front.
+// Each tile is generated on its first request and the most recently used ones are kept in memory.
+// Requests:
+//   GET /tiles/<mipID>/<x>/<y> - the encoded tile, 404 if there is no such tile. Level mipID is 2^mipID tiles wide.
+//   GET /stats                 - request and cache counters as JSON.
+// Endpoints are "unix:<socket path>", "<port>" or "<address>:<port>". A bare port only listens on 127.0.0.1.
+
+// Encodes the tile at the given tile mipID and tile coordinates. Returns false if there is no such tile.
+// Never called concurrently, since generating tiles means using DevIL and DevIL keeps global state.
+typedef std::function<bool(const unsigned int &mipID, const unsigned int &x, const unsigned int &y, std::vector<uint8_t> &encoded)> tile_generator;
+
+struct tile_server_stats
+{
+	uint64_t requests        = 0;
+	uint64_t tiles_generated = 0;
+	uint64_t tiles_not_found = 0;
+	uint64_t cache_hits      = 0;
+	uint64_t cache_misses    = 0;
+	uint64_t cache_bytes     = 0;
+	uint64_t cached_tiles    = 0;
+};
+
+// MIME type to send tiles encoded in the image format of the given file extension with.
+std::string content_type_for_extension(const std::string &file_extension);
+
+struct tile_server_state;
+
+class tile_server
+{
+public:
+	// Tiles are served for mipIDs below levels only.
+	tile_server(const tile_generator &generator, const unsigned int &levels, const std::string &content_type, const size_t &cache_bytes, const unsigned int &threads);
+	~tile_server();
+
+	// Returns false if the endpoint can't be made sense of or can't be listened on. error() tells why.
+	bool listen(const std::string &endpoint);
+
+	// Serves until SIGINT or SIGTERM comes in, or stop() is called.
+	void run();
+	void stop();
+
+	const std::string &error() const { return m_error; }
+	tile_server_stats  stats() const;
+
+private:
+	std::unique_ptr<tile_server_state> m_state;
+	unsigned int                       m_threads;
+	std::string                        m_error;
+};
+
+#endif // TILE_SERVER_H
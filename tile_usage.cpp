@@ -0,0 +1,86 @@
+#include "tile_usage.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "tile_pack.h" // tile_pack_key
+
+bool tile_usage_histogram::load(const std::string &file_path, std::string &error)
+{
+	std::ifstream file(file_path);
+	if (!file)
+	{
+		error = "Couldn't open " + file_path;
+		return false;
+	}
+
+	std::string line;
+	for (size_t line_number = 1; std::getline(file, line); line_number++)
+	{
+		if (line.empty() || line[0] == '#' || line.find_first_not_of(" \t\r") == std::string::npos)
+		{
+			continue;
+		}
+		std::istringstream fields(line);
+		unsigned int mipID, x, y;
+		uint64_t count = 1;
+		if (!(fields >> mipID >> x >> y) || (!(fields >> count) && !fields.eof()))
+		{
+			error = "Couldn't read line " + std::to_string(line_number) + " of " + file_path;
+			return false;
+		}
+		m_counts[tile_pack_key(mipID, x, y)] += count;
+	}
+	return true;
+}
+
+void tile_usage_histogram::add_to_coarser_tiles()
+{
+	uint32_t finest_mipID = 0;
+	for (const std::pair<const uint64_t, uint64_t> &tile : m_counts)
+	{
+		finest_mipID = std::max(finest_mipID, (uint32_t)(tile.first >> 48));
+	}
+
+	// Finest tiles first, so counts trickle all the way down to mipID 0.
+	for (uint32_t mipID = finest_mipID; mipID > 0; mipID--)
+	{
+		std::vector<std::pair<uint64_t, uint64_t>> tiles;
+		for (const std::pair<const uint64_t, uint64_t> &tile : m_counts)
+		{
+			if ((uint32_t)(tile.first >> 48) == mipID)
+			{
+				tiles.push_back(tile);
+			}
+		}
+		for (const std::pair<uint64_t, uint64_t> &tile : tiles)
+		{
+			// Tile (x, y) is a quarter of tile (x / 2, y / 2) one mipID coarser, whichever corner y counts from.
+			const uint32_t x = (uint32_t)((tile.first >> 24) & 0xFFFFFF);
+			const uint32_t y = (uint32_t)(tile.first & 0xFFFFFF);
+			m_counts[tile_pack_key(mipID - 1, x / 2, y / 2)] += tile.second;
+		}
+	}
+}
+
+uint64_t tile_usage_histogram::count(const unsigned int &mipID, const unsigned int &x, const unsigned int &y) const
+{
+	const auto found = m_counts.find(tile_pack_key(mipID, x, y));
+	return found == m_counts.end() ? 0 : found->second;
+}
+
+void order_hottest_first(std::vector<planned_tile> &tiles, const tile_usage_histogram &usage)
+{
+	std::vector<std::pair<uint64_t, planned_tile>> counted;
+	counted.reserve(tiles.size());
+	for (const planned_tile &tile : tiles)
+	{
+		counted.push_back({ usage.count(tile.mipID, tile.x, tile.y), tile });
+	}
+	std::stable_sort(counted.begin(), counted.end(), [](const std::pair<uint64_t, planned_tile> &a, const std::pair<uint64_t, planned_tile> &b) { return a.first > b.first; });
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		tiles[i] = counted[i].second;
+	}
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TILE_USAGE_H
+#define TILE_USAGE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// How often a renderer asked for each tile, as reported by its feedback pass. Used to generate the tiles that matter
+// most first, so a build that is cut short still holds them.
+
+struct planned_tile
+{
+	unsigned int mipID;
+	unsigned int x;
+	unsigned int y;
+};
+
+class tile_usage_histogram
+{
+public:
+	// Reads lines "<mipID> <x> <y> [count]", count defaulting to one. Tiles listed more than once add up.
+	// Empty lines and lines starting with # are skipped. On failure, error says why.
+	bool load(const std::string &file_path, std::string &error);
+
+	// A renderer falls back on coarser tiles while finer ones are missing, so every tile is at least as hot as all
+	// tiles it is the coarser version of together.
+	void add_to_coarser_tiles();
+
+	uint64_t count(const unsigned int &mipID, const unsigned int &x, const unsigned int &y) const;
+	size_t   size() const { return m_counts.size(); }
+
+private:
+	std::unordered_map<uint64_t, uint64_t> m_counts;
+};
+
+// Hottest tiles first. Tiles equally hot, including all unused ones, keep their order.
+void order_hottest_first(std::vector<planned_tile> &tiles, const tile_usage_histogram &usage);
+
+#endif // TILE_USAGE_H
@@ -0,0 +1,512 @@
+#include "tile_writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include "build_trace.h"
+#include "config.h"
+
+#ifdef VT_HAVE_LIBURING
+#include <fcntl.h>
+#include <unistd.h>
+#include <liburing.h>
+#endif
+
+bool tile_writer_backend_from_string(const std::string &string, tile_writer_backend &backend)
+{
+	if (string == "auto")
+	{
+		backend = tile_writer_backend_available(tile_writer_backend::uring) ? tile_writer_backend::uring : tile_writer_backend::threads;
+		return true;
+	}
+	if (string == "sync")    { backend = tile_writer_backend::sync;    return true; }
+	if (string == "threads") { backend = tile_writer_backend::threads; return true; }
+	if (string == "uring")   { backend = tile_writer_backend::uring;   return true; }
+	return false;
+}
+
+std::string tile_writer_backend_to_string(const tile_writer_backend &backend)
+{
+	switch (backend)
+	{
+	case tile_writer_backend::sync:    return "sync";
+	case tile_writer_backend::threads: return "threads";
+	case tile_writer_backend::uring:   return "uring";
+	}
+	return "unknown";
+}
+
+bool tile_writer_backend_available(const tile_writer_backend &backend)
+{
+#ifndef VT_HAVE_LIBURING
+	if (backend == tile_writer_backend::uring)
+	{
+		return false;
+	}
+#endif
+	return true;
+}
+
+struct write_job
+{
+	std::string          file_path;
+	std::vector<uint8_t> data;
+};
+
+static bool write_file(const write_job &job)
+{
+	trace_scope span("write", job.file_path);
+	std::ofstream file(job.file_path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(job.data.data()), job.data.size());
+	return (bool)file;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Shared bookkeeping of in-flight bytes, statistics and completions.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class tile_writer::implementation
+{
+public:
+	implementation(const tile_writer_backend &backend, const size_t &max_in_flight_bytes) :
+		m_backend(backend),
+		m_max_in_flight_bytes(max_in_flight_bytes),
+		m_in_flight_bytes(0),
+		m_in_flight_files(0)
+	{}
+	virtual ~implementation() {}
+
+	virtual void submit(write_job &&job) = 0;
+
+	void flush()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_drained.wait(lock, [this] { return m_in_flight_files == 0; });
+	}
+
+	tile_writer_backend backend() const { return m_backend; }
+
+	tile_writer_stats stats()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+
+	void set_completion_callback(const tile_write_callback &callback)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_callback = callback;
+	}
+
+protected:
+	// Waits for room, unless nothing is in flight at all so a single oversized file can't deadlock.
+	void acquire(const size_t &bytes)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_in_flight_files > 0 && m_in_flight_bytes + bytes > m_max_in_flight_bytes)
+		{
+			const auto wait_start = std::chrono::steady_clock::now();
+			m_drained.wait(lock, [this, &bytes] { return m_in_flight_files == 0 || m_in_flight_bytes + bytes <= m_max_in_flight_bytes; });
+			const auto wait_end = std::chrono::steady_clock::now();
+			m_stats.seconds_blocked += std::chrono::duration<double>(wait_end - wait_start).count();
+			if (trace_enabled())
+			{
+				trace_span("write_wait", std::string(), wait_start, wait_end);
+			}
+		}
+		m_in_flight_bytes += bytes;
+		m_in_flight_files++;
+		m_stats.files_submitted++;
+		if (m_in_flight_bytes > m_stats.peak_in_flight_bytes)
+		{
+			m_stats.peak_in_flight_bytes = m_in_flight_bytes;
+		}
+	}
+
+	// The callback runs before the file stops counting as in flight, so flush() also waits for callbacks.
+	void complete(const write_job &job, const bool &success)
+	{
+		tile_write_callback callback;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			callback = m_callback;
+		}
+		if (callback)
+		{
+			callback(job.file_path, job.data.size(), success);
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_in_flight_bytes -= job.data.size();
+			m_in_flight_files--;
+			if (success)
+			{
+				m_stats.files_completed++;
+				m_stats.bytes_completed += job.data.size();
+			}
+			else
+			{
+				m_stats.files_failed++;
+			}
+		}
+		m_drained.notify_all();
+	}
+
+private:
+	const tile_writer_backend m_backend;
+	const size_t              m_max_in_flight_bytes;
+	size_t                    m_in_flight_bytes;
+	size_t                    m_in_flight_files;
+	tile_writer_stats         m_stats;
+	tile_write_callback       m_callback;
+	std::mutex                m_mutex;
+	std::condition_variable   m_drained;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Synchronous backend.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class sync_tile_writer : public tile_writer::implementation
+{
+public:
+	sync_tile_writer() : implementation(tile_writer_backend::sync, 0) {}
+
+	void submit(write_job &&job) override
+	{
+		acquire(job.data.size());
+		complete(job, write_file(job));
+	}
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Thread pool backend.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class threads_tile_writer : public tile_writer::implementation
+{
+public:
+	threads_tile_writer(const unsigned int &threads, const size_t &max_in_flight_bytes) :
+		implementation(tile_writer_backend::threads, max_in_flight_bytes),
+		m_stopping(false)
+	{
+		for (unsigned int i = 0; i < std::max(threads, 1u); i++)
+		{
+			m_threads.emplace_back(&threads_tile_writer::run, this, i);
+		}
+	}
+
+	~threads_tile_writer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_queue_mutex);
+			m_stopping = true;
+		}
+		m_queue_filled.notify_all();
+		for (std::thread &thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	void submit(write_job &&job) override
+	{
+		acquire(job.data.size());
+		{
+			std::lock_guard<std::mutex> lock(m_queue_mutex);
+			m_queue.push_back(std::move(job));
+		}
+		m_queue_filled.notify_one();
+	}
+
+private:
+	void run(const unsigned int index)
+	{
+		trace_thread_name("tile writer " + std::to_string(index));
+		while (true)
+		{
+			write_job job;
+			{
+				std::unique_lock<std::mutex> lock(m_queue_mutex);
+				m_queue_filled.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+				if (m_queue.empty())
+				{
+					return; // Stopping and nothing left to do.
+				}
+				job = std::move(m_queue.front());
+				m_queue.pop_front();
+			}
+			complete(job, write_file(job));
+		}
+	}
+
+	std::vector<std::thread> m_threads;
+	std::deque<write_job>    m_queue;
+	std::mutex               m_queue_mutex;
+	std::condition_variable  m_queue_filled;
+	bool                     m_stopping;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// io_uring backend.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef VT_HAVE_LIBURING
+class uring_tile_writer : public tile_writer::implementation
+{
+public:
+	uring_tile_writer(const size_t &max_in_flight_bytes, const unsigned int &batch_size) :
+		implementation(tile_writer_backend::uring, max_in_flight_bytes),
+		m_batch_size(std::max(batch_size, 1u)),
+		m_queue_depth(std::max(2 * m_batch_size, 64u)),
+		m_initialised(false),
+		m_stopping(false)
+	{
+		m_initialised = io_uring_queue_init(m_queue_depth, &m_ring, 0) == 0;
+		if (m_initialised)
+		{
+			m_thread = std::thread(&uring_tile_writer::run, this);
+		}
+	}
+
+	~uring_tile_writer()
+	{
+		if (!m_initialised)
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_queue_mutex);
+			m_stopping = true;
+		}
+		m_queue_filled.notify_all();
+		m_thread.join();
+		io_uring_queue_exit(&m_ring);
+	}
+
+	// Kernels without io_uring support (or containers that block it) fail here. The caller falls back to threads.
+	bool initialised() const { return m_initialised; }
+
+	void submit(write_job &&job) override
+	{
+		acquire(job.data.size());
+		{
+			std::lock_guard<std::mutex> lock(m_queue_mutex);
+			m_queue.push_back(std::move(job));
+		}
+		m_queue_filled.notify_one();
+	}
+
+private:
+	// Each file goes through open, one or more writes, and close. Only one request per file is in the ring at a time.
+	enum class stage { open, write, close };
+	struct uring_job
+	{
+		write_job job;
+		stage     current_stage = stage::open;
+		int       file_descriptor = -1;
+		size_t    bytes_written = 0;
+		bool      success = true;
+		std::chrono::steady_clock::time_point started;
+	};
+
+	void prepare(uring_job *job)
+	{
+		io_uring_sqe *sqe = io_uring_get_sqe(&m_ring);
+		switch (job->current_stage)
+		{
+		case stage::open:
+			io_uring_prep_openat(sqe, AT_FDCWD, job->job.file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			break;
+		case stage::write:
+			io_uring_prep_write(sqe, job->file_descriptor, job->job.data.data() + job->bytes_written, (unsigned int)(job->job.data.size() - job->bytes_written), job->bytes_written);
+			break;
+		case stage::close:
+			io_uring_prep_close(sqe, job->file_descriptor);
+			break;
+		}
+		io_uring_sqe_set_data(sqe, job);
+	}
+
+	// Returns true if the job is finished.
+	bool advance(uring_job *job, const int &result)
+	{
+		switch (job->current_stage)
+		{
+		case stage::open:
+			if (result < 0)
+			{
+				job->success = false;
+				return true;
+			}
+			job->file_descriptor = result;
+			job->current_stage = job->job.data.empty() ? stage::close : stage::write;
+			break;
+		case stage::write:
+			if (result <= 0)
+			{
+				job->success = false;
+				job->current_stage = stage::close;
+				break;
+			}
+			job->bytes_written += (size_t)result;
+			if (job->bytes_written >= job->job.data.size())
+			{
+				job->current_stage = stage::close;
+			}
+			break;
+		case stage::close:
+			job->success = job->success && result >= 0;
+			return true;
+		}
+		prepare(job);
+		return false;
+	}
+
+	void run()
+	{
+		trace_thread_name("tile writer io_uring");
+		unsigned int active = 0;
+		while (true)
+		{
+			// Pick up a batch of new files, as many as there is room for in the ring.
+			std::vector<write_job> batch;
+			{
+				std::unique_lock<std::mutex> lock(m_queue_mutex);
+				if (active == 0)
+				{
+					m_queue_filled.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+					if (m_queue.empty())
+					{
+						return; // Stopping and nothing left to do.
+					}
+				}
+				while (!m_queue.empty() && batch.size() < m_batch_size && active + batch.size() < m_queue_depth)
+				{
+					batch.push_back(std::move(m_queue.front()));
+					m_queue.pop_front();
+				}
+			}
+			for (write_job &job : batch)
+			{
+				uring_job *new_job = new uring_job();
+				new_job->job = std::move(job);
+				new_job->started = std::chrono::steady_clock::now();
+				prepare(new_job);
+				active++;
+			}
+			io_uring_submit(&m_ring);
+
+			// Wait for at least one completion, then reap whatever else is ready.
+			io_uring_cqe *cqe = nullptr;
+			if (io_uring_wait_cqe(&m_ring, &cqe) < 0)
+			{
+				continue;
+			}
+			while (cqe)
+			{
+				uring_job *job = static_cast<uring_job*>(io_uring_cqe_get_data(cqe));
+				const int result = cqe->res;
+				io_uring_cqe_seen(&m_ring, cqe);
+				if (advance(job, result))
+				{
+					// Files are in flight side by side, so their spans overlap.
+					if (trace_enabled())
+					{
+						trace_async_span("write", job->job.file_path, job->started, std::chrono::steady_clock::now());
+					}
+					complete(job->job, job->success);
+					delete job;
+					active--;
+				}
+				cqe = nullptr;
+				if (io_uring_peek_cqe(&m_ring, &cqe) != 0)
+				{
+					cqe = nullptr;
+				}
+			}
+			io_uring_submit(&m_ring); // Follow-up writes and closes.
+		}
+	}
+
+	const unsigned int      m_batch_size;
+	const unsigned int      m_queue_depth;
+	io_uring                m_ring;
+	bool                    m_initialised;
+	std::thread             m_thread;
+	std::deque<write_job>   m_queue;
+	std::mutex              m_queue_mutex;
+	std::condition_variable m_queue_filled;
+	bool                    m_stopping;
+};
+#endif
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Front end.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+tile_writer::tile_writer(const tile_writer_backend &backend, const unsigned int &threads, const size_t &max_in_flight_bytes, const unsigned int &batch_size)
+{
+#ifdef VT_HAVE_LIBURING
+	if (backend == tile_writer_backend::uring)
+	{
+		uring_tile_writer *uring_writer = new uring_tile_writer(max_in_flight_bytes, batch_size);
+		m_implementation.reset(uring_writer);
+		if (uring_writer->initialised())
+		{
+			return;
+		}
+	}
+#else
+	(void)batch_size; // Only the io_uring writer batches.
+#endif
+	if (backend == tile_writer_backend::sync)
+	{
+		m_implementation.reset(new sync_tile_writer());
+	}
+	else
+	{
+		m_implementation.reset(new threads_tile_writer(threads, max_in_flight_bytes));
+	}
+}
+
+tile_writer::~tile_writer()
+{
+	flush();
+}
+
+void tile_writer::set_completion_callback(const tile_write_callback &callback)
+{
+	m_implementation->set_completion_callback(callback);
+}
+
+void tile_writer::submit(const std::string &file_path, std::vector<uint8_t> &&data)
+{
+	write_job job = { file_path, std::move(data) };
+	m_implementation->submit(std::move(job));
+}
+
+void tile_writer::flush()
+{
+	m_implementation->flush();
+}
+
+tile_writer_backend tile_writer::backend() const
+{
+	return m_implementation->backend();
+}
+
+tile_writer_stats tile_writer::stats() const
+{
+	return m_implementation->stats();
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TILE_WRITER_H
+#define TILE_WRITER_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Writes already encoded files off the main thread, so tile cutting and encoding don't stall on filesystem latency.
+// Backends:
+//   uring   - one I/O thread driving Linux io_uring, opening, writing and closing files in submitted batches.
+//   threads - a pool of threads doing plain blocking writes. Works everywhere.
+//   sync    - writes on the calling thread, as if there were no writer at all.
+// submit() blocks while more than max_in_flight_bytes are waiting to be written, which bounds memory use.
+
+enum class tile_writer_backend
+{
+	sync,
+	threads,
+	uring,
+};
+
+bool        tile_writer_backend_from_string(const std::string &string, tile_writer_backend &backend); // "auto" picks the best available.
+std::string tile_writer_backend_to_string(const tile_writer_backend &backend);
+bool        tile_writer_backend_available(const tile_writer_backend &backend);
+
+struct tile_writer_stats
+{
+	uint64_t files_submitted = 0;
+	uint64_t files_completed = 0;
+	uint64_t files_failed    = 0;
+	uint64_t bytes_completed = 0;
+	uint64_t peak_in_flight_bytes = 0;
+	double   seconds_blocked = 0.0; // Time submit() spent waiting for in-flight bytes to drain.
+};
+
+// Called on completion of every file, possibly from an I/O thread. Keep it short and thread-safe.
+typedef std::function<void(const std::string &file_path, const size_t &bytes, const bool &success)> tile_write_callback;
+
+class tile_writer
+{
+public:
+	tile_writer(const tile_writer_backend &backend, const unsigned int &threads, const size_t &max_in_flight_bytes, const unsigned int &batch_size);
+	~tile_writer(); // Flushes.
+
+	void set_completion_callback(const tile_write_callback &callback);
+
+	void submit(const std::string &file_path, std::vector<uint8_t> &&data);
+
+	// Blocks until everything submitted so far has completed.
+	void flush();
+
+	tile_writer_backend backend() const;
+	tile_writer_stats   stats() const;
+
+	class implementation;
+
+private:
+	std::unique_ptr<implementation> m_implementation;
+};
+
+#endif // TILE_WRITER_H
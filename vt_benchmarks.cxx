@@ -0,0 +1,395 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// vtBenchmarks times the kernels a vtTileCreator run spends its time in, each on its own and over a sweep of tile
+// sizes, border widths and channel counts, so a change to one of them can be measured without running whole builds.
+// Results are written as JSON.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "DevIL/devil_cpp_wrapper.h"
+#include "RectangleBinPack/RectangleBinPack.h"
+
+#include "atlas_regions.h"
+#include "helper_functions.h"
+#include "image_kernels.h"
+#include "mipmap_resample.h"
+#include "tile_pack.h"
+
+using namespace rbp;
+namespace po = boost::program_options;
+
+struct benchmark_result
+{
+	std::string name;
+	std::string kernel;
+	std::vector<std::pair<std::string, std::string>> parameters;
+	uint64_t    iterations;
+	double      seconds;
+	uint64_t    items_per_op;
+	uint64_t    bytes_per_op;
+};
+
+// Runs setup and op until op alone has taken at least min_time seconds, timing only op. Setup is for restoring
+// whatever op consumes, so every op starts from the same state.
+static void measure(const double &min_time, const std::function<void()> &setup, const std::function<void()> &op, benchmark_result &result)
+{
+	// A first run to warm up caches and let DevIL allocate what it keeps around. Only counted if it alone took long
+	// enough, which saves running slow ops like packing 100k rectangles twice.
+	setup();
+	const auto warm_up_start = std::chrono::steady_clock::now();
+	op();
+	const double warm_up_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - warm_up_start).count();
+	if (warm_up_seconds >= min_time)
+	{
+		result.iterations = 1;
+		result.seconds    = warm_up_seconds;
+		return;
+	}
+
+	result.iterations = 0;
+	result.seconds    = 0.0;
+	while (result.seconds < min_time)
+	{
+		setup();
+		const auto start = std::chrono::steady_clock::now();
+		op();
+		result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.iterations++;
+	}
+}
+
+// Smooth gradients with some noise on top, so encoders have about as much to do as with a real texture.
+static void fill_test_pattern(ILubyte *texels, const unsigned int &texels_wide, const unsigned int &texels_high, const unsigned int &channels, std::mt19937 &random)
+{
+	std::uniform_int_distribution<int> noise(-12, 12);
+	for (unsigned int y = 0; y < texels_high; y++)
+	{
+		for (unsigned int x = 0; x < texels_wide; x++)
+		{
+			for (unsigned int c = 0; c < channels; c++)
+			{
+				const int gradient = (int)((x * (c + 1) + y * (channels - c)) * 255 / (texels_wide + texels_high)) % 256;
+				texels[((size_t)y * texels_wide + x) * channels + c] = (ILubyte)std::min(255, std::max(0, gradient + noise(random)));
+			}
+		}
+	}
+}
+
+static void create_test_image(ilImage &image, const unsigned int &texels_wide, const unsigned int &texels_high, const texel_layout &layout, std::mt19937 &random)
+{
+	ilState::Enable(IL_ORIGIN_SET);
+	ilState::Origin(IL_ORIGIN_UPPER_LEFT);
+	image.TexImage(texels_wide, texels_high, 1, layout.bytes_per_texel, layout.format, layout.type, NULL);
+	fill_test_pattern(image.GetData(), texels_wide, texels_high, layout.bytes_per_texel, random);
+}
+
+static void write_json(std::ostream &out, const double &min_time, const std::vector<benchmark_result> &results)
+{
+	out << "{\n\t\"min_time\": " << min_time << ",\n\t\"benchmarks\": [";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const benchmark_result &result = results[i];
+		const double ns_per_op = result.seconds * 1e9 / result.iterations;
+		out << (i ? "," : "") << "\n\t\t{\"name\": " << json_quote(result.name) << ", \"kernel\": " << json_quote(result.kernel) << ", \"parameters\": {";
+		for (size_t p = 0; p < result.parameters.size(); p++)
+		{
+			out << (p ? ", " : "") << json_quote(result.parameters[p].first) << ": ";
+			const std::string &value = result.parameters[p].second;
+			out << (std::all_of(value.begin(), value.end(), ::isdigit) ? value : json_quote(value)); // Numbers stay numbers.
+		}
+		out << "}, \"iterations\": " << result.iterations
+			<< ", \"ns_per_op\": " << ns_per_op
+			<< ", \"items_per_second\": " << result.items_per_op * 1e9 / ns_per_op
+			<< ", \"bytes_per_second\": " << result.bytes_per_op * 1e9 / ns_per_op << "}";
+	}
+	out << "\n\t]\n}" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Parse command line options.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	std::string output_path;
+	std::string filter;
+	double      min_time;
+
+	po::options_description options("Allowed options");
+	options.add_options()
+		("help", "produce help message")
+		("output,o", po::value< std::string >(&output_path)->default_value(""), "JSON file to write results to, standard output if not given")
+		("filter", po::value< std::string >(&filter)->default_value(""), "only run benchmarks whose name contains this")
+		("min-time", po::value<double>(&min_time)->default_value(0.2), "seconds to keep repeating each benchmark for")
+		;
+
+	po::variables_map variables;
+	po::store(po::parse_command_line(argc, argv, options), variables);
+	po::notify(variables);
+
+	if (variables.count("help"))
+	{
+		std::cout << "vtBenchmarks times the image and packing kernels of vtTileCreator.\n"
+			<< options << std::endl;
+		return 1;
+	}
+
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Run the benchmarks.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	const std::vector<unsigned int> tile_sizes     = { 128, 256, 512 };
+	const std::vector<unsigned int> border_widths  = { 1, 4, 8 };
+	const std::vector<unsigned int> channel_counts = { 1, 2, 3, 4 };
+	const std::vector<std::string>  tile_formats   = { ".png", ".tga", ".bmp", ".jpg" };
+	const std::vector<unsigned int> rectangle_counts = { 1000, 10000, 100000 };
+	const std::vector<tile_codec>   tile_codecs    = { tile_codec::raw, tile_codec::lz4, tile_codec::zstd };
+	const std::vector<size_t>       dictionary_sizes = { 0, 64 * 1024 };
+
+	std::vector<benchmark_result> results;
+	std::mt19937 random(2017); // Fixed seed, so every run sees the same texels.
+
+	// Runs one benchmark if its name passes the filter. Progress goes to the console unless it is taken by the JSON.
+	auto run = [&](const std::string &kernel, const std::vector<std::pair<std::string, std::string>> &parameters, const uint64_t &items_per_op, const uint64_t &bytes_per_op,
+		const std::function<void()> &setup, const std::function<void()> &op)
+	{
+		std::string name = kernel;
+		for (const auto &parameter : parameters)
+		{
+			name += "/" + parameter.first + "=" + parameter.second;
+		}
+		if (name.find(filter) == std::string::npos)
+		{
+			return;
+		}
+
+		benchmark_result result;
+		result.name         = name;
+		result.kernel       = kernel;
+		result.parameters   = parameters;
+		result.items_per_op = items_per_op;
+		result.bytes_per_op = bytes_per_op;
+		measure(min_time, setup, op, result);
+		results.push_back(result);
+
+		if (!output_path.empty())
+		{
+			std::cout << name << ": " << result.seconds * 1e9 / result.iterations << " ns/op, " << result.iterations << " iterations." << std::endl;
+		}
+	};
+	const auto no_setup = []() {};
+	const auto text = [](const unsigned int &value) { return std::to_string(value); };
+
+	for (const unsigned int &channels : channel_counts)
+	{
+		const texel_layout layout = texel_layout_for_channels(channels);
+
+		for (const unsigned int &tile_texels_wide : tile_sizes)
+		{
+			const uint64_t tile_bytes = (uint64_t)tile_texels_wide * tile_texels_wide * channels;
+
+			// Bordering a subtexture the size of a tile.
+			for (const unsigned int &border_texels_wide : border_widths)
+			{
+				ilImage original, subtexture;
+				create_test_image(original, tile_texels_wide, tile_texels_wide, layout, random);
+				run("inset_border", { { "texels_wide", text(tile_texels_wide) }, { "border", text(border_texels_wide) }, { "channels", text(channels) } },
+					(uint64_t)tile_texels_wide * tile_texels_wide, tile_bytes,
+					[&]() { subtexture = original; },
+					[&]() { add_inset_border(subtexture, border_texels_wide, layout); });
+			}
+
+			// Copying a subtexture the size of a tile onto the atlas, walking over the atlas so it isn't always the same spot.
+			{
+				const unsigned int atlas_texels_wide = 4096;
+				ilImage atlas, subtexture;
+				create_test_image(atlas, atlas_texels_wide, atlas_texels_wide, layout, random);
+				create_test_image(subtexture, tile_texels_wide, tile_texels_wide, layout, random);
+				const unsigned int spots_wide = atlas_texels_wide / tile_texels_wide;
+				unsigned int spot = 0;
+				run("atlas_overlay", { { "texels_wide", text(tile_texels_wide) }, { "channels", text(channels) } },
+					(uint64_t)tile_texels_wide * tile_texels_wide, tile_bytes,
+					no_setup,
+					[&]() {
+						overlay_image(atlas, subtexture, (spot % spots_wide) * tile_texels_wide, (spot / spots_wide % spots_wide) * tile_texels_wide);
+						spot++;
+					});
+			}
+
+			// Cutting every tile of a mipmap level eight tiles wide, one per op.
+			for (const unsigned int &border_texels_wide : border_widths)
+			{
+				const unsigned int level_tiles_wide  = 8;
+				const unsigned int level_texels_wide = level_tiles_wide * (tile_texels_wide - 2 * border_texels_wide);
+				ilImage level, tile;
+				create_test_image(level, level_texels_wide, level_texels_wide, layout, random);
+				unsigned int next_tile = 0;
+				run("tile_extract", { { "tile", text(tile_texels_wide) }, { "border", text(border_texels_wide) }, { "channels", text(channels) } },
+					1, tile_bytes,
+					no_setup,
+					[&]() {
+						cut_tile(level, next_tile % level_tiles_wide, next_tile / level_tiles_wide % level_tiles_wide, tile_texels_wide, border_texels_wide, layout, tile);
+						next_tile++;
+					});
+			}
+
+			// Encoding a tile in every tile format. Not every format takes every channel count, those are left out.
+			for (const std::string &tile_format : tile_formats)
+			{
+				ilImage tile;
+				create_test_image(tile, tile_texels_wide, tile_texels_wide, layout, random);
+				std::vector<uint8_t> encoded;
+				if (!encode_image(tile, tile_format, encoded))
+				{
+					continue;
+				}
+				run("tile_encode", { { "tile", text(tile_texels_wide) }, { "channels", text(channels) }, { "format", tile_format.substr(1) } },
+					1, tile_bytes,
+					no_setup,
+					[&]() { encode_image(tile, tile_format, encoded); });
+			}
+		}
+
+		// Downsampling a whole mipmap level into the next one.
+		{
+			const unsigned int source_texels_wide = 2048;
+			const unsigned int destination_texels_wide = source_texels_wide / 2;
+			std::vector<uint8_t> source((size_t)source_texels_wide * source_texels_wide * channels);
+			std::vector<uint8_t> destination((size_t)destination_texels_wide * destination_texels_wide * channels);
+			fill_test_pattern(source.data(), source_texels_wide, source_texels_wide, channels, random);
+			atlas_rectangle whole_level;
+			whole_level.width  = destination_texels_wide;
+			whole_level.height = destination_texels_wide;
+			run("mip_downsample", { { "texels_wide", text(source_texels_wide) }, { "channels", text(channels) } },
+				(uint64_t)destination_texels_wide * destination_texels_wide, source.size(),
+				no_setup,
+				[&]() {
+					resample_region(source.data(), source_texels_wide, source_texels_wide,
+						destination.data(), destination_texels_wide, destination_texels_wide, channels, whole_level);
+				});
+		}
+	}
+
+	// Reading tiles back from a tile pack, one per op, as a renderer paging them in would. Every codec with and without
+	// a dictionary, so the decode cost of either shows.
+	for (const unsigned int &tile_texels_wide : tile_sizes)
+	{
+		const unsigned int channels           = 3;
+		const unsigned int border_texels_wide = 4;
+		const unsigned int level_tiles_wide   = 8;
+		const texel_layout layout = texel_layout_for_channels(channels);
+		const uint64_t tile_bytes = (uint64_t)tile_texels_wide * tile_texels_wide * channels;
+
+		// Cut the tiles from a level once, so every pack holds the same ones.
+		ilImage level, tile;
+		create_test_image(level, level_tiles_wide * (tile_texels_wide - 2 * border_texels_wide), level_tiles_wide * (tile_texels_wide - 2 * border_texels_wide), layout, random);
+		std::vector<std::vector<uint8_t>> tiles;
+		for (unsigned int i = 0; i < level_tiles_wide * level_tiles_wide; i++)
+		{
+			cut_tile(level, i % level_tiles_wide, i / level_tiles_wide, tile_texels_wide, border_texels_wide, layout, tile);
+			tiles.emplace_back(tile.GetData(), tile.GetData() + tile_bytes);
+		}
+
+		for (const tile_codec &codec : tile_codecs)
+		{
+			if (!tile_codec_available(codec))
+			{
+				continue;
+			}
+			for (const size_t &dictionary_bytes : dictionary_sizes)
+			{
+				if (codec == tile_codec::raw && dictionary_bytes > 0)
+				{
+					continue;
+				}
+				const std::string pack_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("vt_benchmark_%%%%%%%%.vtpack")).string();
+				{
+					tile_pack_writer writer(pack_path, codec, codec == tile_codec::zstd ? 3 : 1, tile_texels_wide, border_texels_wide, channels, dictionary_bytes, tiles.size() / 4);
+					for (size_t i = 0; i < tiles.size(); i++)
+					{
+						writer.add_tile(0, (uint32_t)(i % level_tiles_wide), (uint32_t)(i / level_tiles_wide), tiles[i].data(), tiles[i].size());
+					}
+				}
+				tile_pack_reader reader;
+				if (reader.open(pack_path))
+				{
+					std::vector<uint8_t> texels;
+					unsigned int next_tile = 0;
+					run("tile_pack_read", { { "tile", text(tile_texels_wide) }, { "codec", tile_codec_to_string(codec) }, { "dictionary", text((unsigned int)reader.header().dictionary_size) } },
+						1, tile_bytes,
+						no_setup,
+						[&]() {
+							reader.read_tile(0, next_tile % level_tiles_wide, next_tile / level_tiles_wide % level_tiles_wide, texels);
+							next_tile++;
+						});
+				}
+				boost::system::error_code ignored;
+				boost::filesystem::remove(pack_path, ignored);
+			}
+		}
+	}
+
+	// Packing subtextures of random sizes into a bin with room to spare. One op packs them all, since inserting gets
+	// slower the more the bin holds. Every insert walks the whole tree so far, so 100k rectangles take minutes.
+	for (const unsigned int &rectangle_count : rectangle_counts)
+	{
+		std::uniform_int_distribution<int> side(16, 256);
+		std::vector<std::pair<int, int>> rectangles(rectangle_count);
+		uint64_t total_area = 0;
+		for (std::pair<int, int> &rectangle : rectangles)
+		{
+			rectangle = { side(random), side(random) };
+			total_area += (uint64_t)rectangle.first * rectangle.second;
+		}
+		const int bin_texels_wide = (int)std::sqrt(total_area * 4.0);
+		RectangleBinPack bin;
+		run("rectbinpack_insert", { { "rectangles", text(rectangle_count) } },
+			rectangle_count, 0,
+			[&]() { bin.Init(bin_texels_wide, bin_texels_wide); },
+			[&]() {
+				for (const std::pair<int, int> &rectangle : rectangles)
+				{
+					bin.Insert(rectangle.first, rectangle.second);
+				}
+			});
+	}
+
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Report.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	if (output_path.empty())
+	{
+		write_json(std::cout, min_time, results);
+		return 0;
+	}
+	std::ofstream output(output_path);
+	if (!output)
+	{
+		std::cout << "Couldn't write " << output_path << ". Exiting..." << std::endl;
+		return 1;
+	}
+	write_json(output, min_time, results);
+	std::cout << "Wrote " << results.size() << " benchmark results to " << output_path << "." << std::endl;
+	return 0;
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// vtBinPackCheck exercises what an incremental build asks of the atlas bin: reserving the placements of a previous
+// build, including areas that span several free leaves of the tree, refusing overlaps, and fitting new and resized
+// subtextures into what's left. It also checks which tiles such a change invalidates. Run by CTest, no images needed.
+
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "RectangleBinPack/RectangleBinPack.h"
+
+#include "atlas_regions.h"
+#include "helper_functions.h"
+#include "mipmap_resample.h"
+
+using namespace rbp;
+
+static bool passed = true;
+
+static void check(const bool &condition, const std::string &description)
+{
+	std::cout << (condition ? "ok   " : "FAIL ") << description << std::endl;
+	passed = passed && condition;
+}
+
+static bool overlaps(const atlas_rectangle &a, const atlas_rectangle &b)
+{
+	return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+static atlas_rectangle rectangle(const unsigned int &x, const unsigned int &y, const unsigned int &width, const unsigned int &height)
+{
+	atlas_rectangle result;
+	result.x      = x;
+	result.y      = y;
+	result.width  = width;
+	result.height = height;
+	return result;
+}
+
+static bool reserve(RectangleBinPack &bin, const atlas_rectangle &area)
+{
+	return bin.Reserve((int)area.x, (int)area.y, (int)area.width, (int)area.height);
+}
+
+// Placements must stay inside the bin and clear of each other.
+static bool disjoint_and_inside(const std::vector<atlas_rectangle> &placements, const unsigned int &bin_texels_wide)
+{
+	for (size_t i = 0; i < placements.size(); i++)
+	{
+		if (placements[i].x + placements[i].width > bin_texels_wide || placements[i].y + placements[i].height > bin_texels_wide)
+		{
+			return false;
+		}
+		for (size_t j = i + 1; j < placements.size(); j++)
+		{
+			if (overlaps(placements[i], placements[j]))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// The tiles of the finest level whose texels, border included, come from any of the changed atlas rectangles. Worked
+// out tile by tile, independently of tiles_overlapping.
+static size_t count_invalidated_tiles(const std::vector<atlas_rectangle> &changed, const unsigned int &atlas_texels_wide,
+	const unsigned int &tile_texels_wide, const unsigned int &tile_border_texels_wide)
+{
+	const unsigned int mipID               = mipIDForDimensions(atlas_texels_wide / tile_texels_wide);
+	const unsigned int level_texels_wide   = mipmap_texels_wide_scaled(mipID, tile_texels_wide, tile_border_texels_wide);
+	const unsigned int payload_texels_wide = tile_texels_wide - 2 * tile_border_texels_wide;
+	const int          level_tiles_wide    = (int)(level_texels_wide / payload_texels_wide);
+
+	std::vector<atlas_rectangle> regions;
+	for (const atlas_rectangle &area : changed)
+	{
+		regions.push_back(mipmap_region_for(area, atlas_texels_wide, level_texels_wide));
+	}
+
+	size_t count = 0;
+	for (int tile_y = 0; tile_y < level_tiles_wide; tile_y++)
+	{
+		for (int tile_x = 0; tile_x < level_tiles_wide; tile_x++)
+		{
+			// Tile coordinates have a lower left origin, texels an upper left one.
+			const int left   = std::max(0, tile_x * (int)payload_texels_wide - (int)tile_border_texels_wide);
+			const int top    = std::max(0, (level_tiles_wide - 1 - tile_y) * (int)payload_texels_wide - (int)tile_border_texels_wide);
+			const int right  = std::min((int)level_texels_wide, (tile_x + 1) * (int)payload_texels_wide + (int)tile_border_texels_wide);
+			const int bottom = std::min((int)level_texels_wide, (level_tiles_wide - tile_y) * (int)payload_texels_wide + (int)tile_border_texels_wide);
+			const atlas_rectangle tile = rectangle(left, top, right - left, bottom - top);
+			for (const atlas_rectangle &region : regions)
+			{
+				if (region.width > 0 && region.height > 0 && overlaps(tile, region))
+				{
+					count++;
+					break;
+				}
+			}
+		}
+	}
+	return count;
+}
+
+int main(int, char *[])
+{
+	// A bin with one rectangle inserted: used space top left, free leaves to its right and below.
+	{
+		RectangleBinPack bin;
+		bin.Init(256, 256);
+		bin.Insert(100, 100);
+
+		check(reserve(bin, rectangle(150, 80, 60, 60)), "reserve an area spanning two free leaves");
+		check(bin.Occupancy() == (100.0f * 100 + 60 * 60) / (256 * 256), "occupancy counts the reserved area once");
+		check(!reserve(bin, rectangle(50, 50, 100, 100)), "refuse an area partly overlapping an inserted rectangle");
+		check(!reserve(bin, rectangle(160, 90, 10, 10)), "refuse an area inside a reserved one");
+		check(!reserve(bin, rectangle(200, 200, 100, 100)), "refuse an area reaching outside the bin");
+
+		// A refused area may leave the tree split up half way. Builds start over from Init then, which must clear it.
+		bin.Init(256, 256);
+		check(bin.Occupancy() == 0.0f, "init clears what a refused reservation left behind");
+		check(reserve(bin, rectangle(50, 50, 100, 100)), "reserve into the cleared bin");
+	}
+
+	// Reserving the exact leaves Insert made, and areas cutting across many of them.
+	{
+		RectangleBinPack bin;
+		bin.Init(512, 512);
+		check(reserve(bin, rectangle(0, 0, 512, 512)), "reserve the whole bin");
+		check(!bin.Insert(1, 1), "nothing fits in a fully reserved bin");
+
+		bin.Init(512, 512);
+		for (unsigned int i = 0; i < 8; i++)
+		{
+			check(reserve(bin, rectangle(i * 64, i * 64, 64, 64)), "reserve diagonal block " + std::to_string(i));
+		}
+		check(reserve(bin, rectangle(64, 0, 448, 64)), "reserve a strip across the leaves the diagonal left");
+		check(!reserve(bin, rectangle(0, 100, 200, 20)), "refuse a strip crossing a diagonal block");
+	}
+
+	// An incremental build: the previous build's placements are reserved, one subtexture was removed, one grew, one
+	// is new. Unchanged placements are taken as they were, the fitted ones must land in the free space around them.
+	{
+		const unsigned int atlas_texels_wide       = 2048;
+		const unsigned int tile_texels_wide        = 128;
+		const unsigned int tile_border_texels_wide = 4;
+
+		std::mt19937 random(2017);
+		std::uniform_int_distribution<int> side(32, 256);
+		RectangleBinPack previous_bin;
+		previous_bin.Init(atlas_texels_wide, atlas_texels_wide);
+		std::vector<atlas_rectangle> previous;
+		for (unsigned int i = 0; i < 40; i++)
+		{
+			const int width = side(random), height = side(random);
+			const std::shared_ptr<RectangleBinPack::Node> node = previous_bin.Insert(width, height);
+			if (node)
+			{
+				previous.push_back(rectangle(node->x, node->y, width, height));
+			}
+		}
+		check(previous.size() >= 20 && disjoint_and_inside(previous, atlas_texels_wide), "previous build packed " + std::to_string(previous.size()) + " subtextures");
+
+		const size_t removed = 3;
+		const size_t resized = 7;
+		RectangleBinPack bin;
+		bin.Init(atlas_texels_wide, atlas_texels_wide);
+		std::vector<atlas_rectangle> placements;
+		bool all_reserved = true;
+		for (size_t i = 0; i < previous.size(); i++)
+		{
+			if (i == removed || i == resized)
+			{
+				continue;
+			}
+			all_reserved = reserve(bin, previous[i]) && all_reserved;
+			placements.push_back(previous[i]);
+		}
+		check(all_reserved, "reserve all unchanged placements of the previous build");
+
+		std::vector<atlas_rectangle> changed = { previous[removed], previous[resized] };
+		const std::vector<std::pair<int, int>> fitted_sizes = { { (int)previous[resized].width + 16, (int)previous[resized].height + 16 }, { 64, 48 } };
+		bool all_fitted = true;
+		for (const std::pair<int, int> &size : fitted_sizes)
+		{
+			const std::shared_ptr<RectangleBinPack::Node> node = bin.Insert(size.first, size.second);
+			all_fitted = all_fitted && node;
+			if (node)
+			{
+				placements.push_back(rectangle(node->x, node->y, size.first, size.second));
+				changed.push_back(placements.back());
+			}
+		}
+		check(all_fitted, "fit the resized and the new subtexture into the free space");
+		check(disjoint_and_inside(placements, atlas_texels_wide), "fitted subtextures don't overlap unchanged ones");
+		uint64_t placed_area = 0;
+		for (const atlas_rectangle &placement : placements)
+		{
+			placed_area += (uint64_t)placement.width * placement.height;
+		}
+		check(bin.Occupancy() == (float)placed_area / ((uint64_t)atlas_texels_wide * atlas_texels_wide), "the bin holds exactly the reserved and fitted area");
+
+		// The tiles an incremental build redoes at the finest level, as vtTileCreator works them out.
+		const unsigned int mipID             = mipIDForDimensions(atlas_texels_wide / tile_texels_wide);
+		const unsigned int level_texels_wide = mipmap_texels_wide_scaled(mipID, tile_texels_wide, tile_border_texels_wide);
+		std::set<tile_coordinate> invalidated;
+		for (const atlas_rectangle &area : changed)
+		{
+			const std::set<tile_coordinate> overlapping = tiles_overlapping(mipmap_region_for(area, atlas_texels_wide, level_texels_wide), mipID, tile_texels_wide, tile_border_texels_wide);
+			invalidated.insert(overlapping.begin(), overlapping.end());
+		}
+		const size_t expected = count_invalidated_tiles(changed, atlas_texels_wide, tile_texels_wide, tile_border_texels_wide);
+		const size_t level_tiles = (size_t)(level_texels_wide / (tile_texels_wide - 2 * tile_border_texels_wide)) * (level_texels_wide / (tile_texels_wide - 2 * tile_border_texels_wide));
+		check(invalidated.size() == expected && expected > 0 && expected < level_tiles,
+			"invalidated " + std::to_string(invalidated.size()) + " of " + std::to_string(level_tiles) + " finest tiles, expected " + std::to_string(expected));
+	}
+
+	if (!passed)
+	{
+		std::cout << "Bin pack check failed." << std::endl;
+	}
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,348 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// vtRegressionCheck checks a finished vtTileCreator run against golden values: a digest of the tiles and xml it
+// wrote, its per stage wall times against budgets and its peak memory against a ceiling. Run by CTest, see the
+// regression tests in CMakeLists.txt. With --update, or VT_REGRESSION_UPDATE=1 in the environment, the golden values
+// are replaced by those of this run instead. Missing golden digests fail the check. Wall times only mean something on
+// the machine and build type that recorded them, so budgets are kept per --budgets-for key, and a key without budgets
+// only gets its output checked.
+
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "pugixml/pugixml.hpp"
+
+#include "content_hash.h"
+
+namespace po = boost::program_options;
+
+// The output folders that should come out the same every run. Intermediate images are left to --emit, the build
+// manifest and journal hold absolute paths.
+static const std::vector<std::string> digested_folders = { "1c_atlas_xml", "3a_tiles", "3b_tiles_xml" };
+
+struct folder_digest
+{
+	uint64_t files = 0;
+	uint64_t bytes = 0;
+	uint64_t hash  = 0;
+};
+
+// Hashes relative paths and contents of all files in a folder, in path order so it doesn't matter in which order
+// they were written.
+static bool digest_folder(const boost::filesystem::path &folder, folder_digest &digest)
+{
+	std::vector<std::string> relative_paths;
+	if (boost::filesystem::is_directory(folder))
+	{
+		for (boost::filesystem::recursive_directory_iterator i(folder), end; i != end; ++i)
+		{
+			if (boost::filesystem::is_regular_file(i->status()))
+			{
+				relative_paths.push_back(boost::filesystem::relative(i->path(), folder).generic_string());
+			}
+		}
+	}
+	std::sort(relative_paths.begin(), relative_paths.end());
+
+	content_hasher hasher;
+	std::vector<char> contents;
+	for (const std::string &relative_path : relative_paths)
+	{
+		std::ifstream file((folder / relative_path).string(), std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			std::cout << "Couldn't read " << (folder / relative_path).string() << "." << std::endl;
+			return false;
+		}
+		contents.resize((size_t)file.tellg());
+		file.seekg(0);
+		file.read(contents.data(), contents.size());
+
+		const uint64_t size = contents.size();
+		hasher.update(relative_path.c_str(), relative_path.size() + 1); // Including the terminator, so names and contents can't run into each other.
+		hasher.update(&size, sizeof(size));
+		hasher.update(contents.data(), contents.size());
+		digest.files++;
+		digest.bytes += size;
+	}
+	digest.hash = hasher.digest();
+	return true;
+}
+
+// Value of "key": in a line of the stats JSON vtTileCreator writes, which puts every stage on a line of its own.
+static bool json_value(const std::string &line, const std::string &key, std::string &value)
+{
+	const std::string pattern = "\"" + key + "\": ";
+	const size_t found = line.find(pattern);
+	if (found == std::string::npos)
+	{
+		return false;
+	}
+	const size_t begin = found + pattern.size();
+	if (line[begin] == '"')
+	{
+		value = line.substr(begin + 1, line.find('"', begin + 1) - begin - 1);
+	}
+	else
+	{
+		value = line.substr(begin, line.find_first_of(",}", begin) - begin);
+	}
+	return true;
+}
+
+struct run_measurements
+{
+	std::map<std::string, double> wall_seconds; // Per stage, and "build" for the whole build.
+	uint64_t                      peak_resident_bytes = 0;
+};
+
+static bool load_stats(const std::string &stats_path, run_measurements &measurements)
+{
+	std::ifstream stats(stats_path);
+	if (!stats)
+	{
+		return false;
+	}
+	std::string line, value;
+	bool in_stages = false;
+	while (std::getline(stats, line))
+	{
+		if (line.find("\"stages\"") != std::string::npos)
+		{
+			in_stages = true;
+		}
+		else if (!in_stages && line.find("\"build\"") != std::string::npos && json_value(line, "wall_seconds", value))
+		{
+			measurements.wall_seconds["build"] = std::atof(value.c_str());
+		}
+		else if (!in_stages && json_value(line, "peak_resident_bytes", value))
+		{
+			measurements.peak_resident_bytes = std::strtoull(value.c_str(), nullptr, 10);
+		}
+		else if (in_stages && json_value(line, "name", value))
+		{
+			std::string wall_seconds;
+			if (json_value(line, "wall_seconds", wall_seconds))
+			{
+				measurements.wall_seconds[value] = std::atof(wall_seconds.c_str());
+			}
+		}
+	}
+	return measurements.wall_seconds.count("build") > 0;
+}
+
+int main(int argc, char *argv[])
+{
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Parse command line options.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	std::string golden_path;
+	std::string run_name;
+	std::string output_path;
+	std::string stats_path;
+	std::string budgets_for;
+	double      time_tolerance;
+	double      time_slack;
+	double      memory_tolerance;
+	bool        update;
+
+	po::options_description options("Allowed options");
+	options.add_options()
+		("help", "produce help message")
+		("golden", po::value< std::string >(&golden_path), "xml file with the golden values of the workload")
+		("run", po::value< std::string >(&run_name)->default_value("default"), "name of the run of the workload to check the budgets of")
+		("output-path,o", po::value< std::string >(&output_path), "output path of the vtTileCreator run")
+		("stats", po::value< std::string >(&stats_path), "--stats-json file of the vtTileCreator run")
+		("budgets-for", po::value< std::string >(&budgets_for)->default_value("default"), "machine and build type the time and memory budgets belong to")
+		("time-tolerance", po::value<double>(&time_tolerance)->default_value(0.5), "fraction a stage may take longer than its budget")
+		("time-slack", po::value<double>(&time_slack)->default_value(0.05), "seconds any stage may take longer than its budget on top of that, for stages too short to time reliably")
+		("memory-tolerance", po::value<double>(&memory_tolerance)->default_value(0.1), "fraction peak resident memory may exceed its ceiling")
+		("update", po::bool_switch(&update), "replace the golden values with those of this run")
+		;
+
+	po::variables_map variables;
+	po::store(po::parse_command_line(argc, argv, options), variables);
+	po::notify(variables);
+
+	if (variables.count("help") || golden_path.empty() || output_path.empty() || stats_path.empty())
+	{
+		std::cout << "vtRegressionCheck checks a vtTileCreator run against golden digests, time budgets and a memory ceiling.\n"
+			<< options << std::endl;
+		return 1;
+	}
+	const char *update_environment = std::getenv("VT_REGRESSION_UPDATE");
+	update = update || (update_environment && std::string(update_environment) != "0" && std::string(update_environment) != "");
+
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Measure the run.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	std::map<std::string, folder_digest> digests;
+	for (const std::string &folder : digested_folders)
+	{
+		if (!digest_folder(boost::filesystem::path(output_path) / folder, digests[folder]))
+		{
+			std::cout << "Couldn't digest the output of the run. Exiting..." << std::endl;
+			return 1;
+		}
+	}
+	if (digests["3a_tiles"].files == 0)
+	{
+		std::cout << "The run in " << output_path << " wrote no tiles. Exiting..." << std::endl;
+		return 1;
+	}
+	run_measurements measured;
+	if (!load_stats(stats_path, measured))
+	{
+		std::cout << "Couldn't read build stats " << stats_path << ". Exiting..." << std::endl;
+		return 1;
+	}
+
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Compare against the golden values, or record them.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	pugi::xml_document golden;
+	golden.load_file(golden_path.c_str());
+	pugi::xml_node xml_regression = golden.child("regression");
+	if (!xml_regression)
+	{
+		golden.reset();
+		xml_regression = golden.append_child("regression");
+	}
+	pugi::xml_node xml_run;
+	for (pugi::xml_node xml_candidate = xml_regression.child("run"); xml_candidate; xml_candidate = xml_candidate.next_sibling("run"))
+	{
+		if (run_name == xml_candidate.attribute("name").value() && budgets_for == xml_candidate.attribute("budgets_for").value())
+		{
+			xml_run = xml_candidate;
+		}
+	}
+
+	// Digests are shared by all runs of the workload and have to be committed. Without them nothing would be checked.
+	if (!update && !xml_regression.child("digest"))
+	{
+		std::cout << "FAIL no golden digests in " << golden_path << ". Record them with VT_REGRESSION_UPDATE=1 ctest and commit them." << std::endl;
+		return 1;
+	}
+	const bool record_digests = update;
+	const bool record_run     = update;
+	bool passed = true;
+
+	if (record_digests)
+	{
+		while (xml_regression.child("digest"))
+		{
+			xml_regression.remove_child("digest");
+		}
+		pugi::xml_node insert_after;
+		for (const std::string &folder : digested_folders)
+		{
+			pugi::xml_node xml_digest = insert_after ? xml_regression.insert_child_after("digest", insert_after) : xml_regression.prepend_child("digest");
+			xml_digest.append_attribute("folder").set_value(folder.c_str());
+			xml_digest.append_attribute("files").set_value((unsigned long long)digests[folder].files);
+			xml_digest.append_attribute("bytes").set_value((unsigned long long)digests[folder].bytes);
+			xml_digest.append_attribute("hash").set_value(hash_to_string(digests[folder].hash).c_str());
+			insert_after = xml_digest;
+		}
+	}
+	else
+	{
+		// Output has to match exactly, whatever the run did to get there.
+		for (const std::string &folder : digested_folders)
+		{
+			const pugi::xml_node xml_digest = xml_regression.find_child_by_attribute("digest", "folder", folder.c_str());
+			uint64_t golden_hash = 0;
+			hash_from_string(xml_digest.attribute("hash").value(), golden_hash);
+			const folder_digest &digest = digests[folder];
+			if (!xml_digest || golden_hash != digest.hash || xml_digest.attribute("files").as_ullong() != digest.files || xml_digest.attribute("bytes").as_ullong() != digest.bytes)
+			{
+				std::cout << "FAIL " << folder << ": " << digest.files << " files, " << digest.bytes << " bytes, hash " << hash_to_string(digest.hash)
+					<< ". Expected " << xml_digest.attribute("files").value() << " files, " << xml_digest.attribute("bytes").value() << " bytes, hash " << xml_digest.attribute("hash").value() << "." << std::endl;
+				passed = false;
+			}
+			else
+			{
+				std::cout << "ok   " << folder << ": " << digest.files << " files, hash " << hash_to_string(digest.hash) << "." << std::endl;
+			}
+		}
+	}
+
+	if (record_run)
+	{
+		xml_regression.remove_child(xml_run);
+		xml_run = xml_regression.append_child("run");
+		xml_run.append_attribute("name").set_value(run_name.c_str());
+		xml_run.append_attribute("budgets_for").set_value(budgets_for.c_str());
+		for (const auto &stage : measured.wall_seconds)
+		{
+			pugi::xml_node xml_stage = xml_run.append_child("stage");
+			xml_stage.append_attribute("name").set_value(stage.first.c_str());
+			xml_stage.append_attribute("wall_seconds").set_value((float)stage.second); // Plenty precise for a budget.
+		}
+		xml_run.append_child("memory").append_attribute("peak_resident_bytes").set_value((unsigned long long)measured.peak_resident_bytes);
+	}
+
+	if (record_digests || record_run)
+	{
+		boost::system::error_code ignored;
+		boost::filesystem::create_directories(boost::filesystem::path(golden_path).parent_path(), ignored);
+		if (!golden.save_file(golden_path.c_str()))
+		{
+			std::cout << "Couldn't save golden values " << golden_path << ". Exiting..." << std::endl;
+			return 1;
+		}
+		std::cout << "Recorded " << (record_digests ? "digests" : "") << (record_digests && record_run ? " and " : "") << (record_run ? "budgets of run " + run_name + " for " + budgets_for : "")
+			<< " in " << golden_path << "." << std::endl;
+	}
+	if (record_run)
+	{
+		return passed ? 0 : 1;
+	}
+	if (!xml_run)
+	{
+		std::cout << "No budgets of run " << run_name << " for " << budgets_for << ", so only its output was checked. Record them with VT_REGRESSION_UPDATE=1 ctest on this machine." << std::endl;
+		return passed ? 0 : 1;
+	}
+
+	// Stages may take a bit longer than their budget, but not much.
+	for (pugi::xml_node xml_stage = xml_run.child("stage"); xml_stage; xml_stage = xml_stage.next_sibling("stage"))
+	{
+		const std::string stage  = xml_stage.attribute("name").value();
+		const double      budget = xml_stage.attribute("wall_seconds").as_double() * (1.0 + time_tolerance) + time_slack;
+		const auto        found  = measured.wall_seconds.find(stage);
+		if (found == measured.wall_seconds.end())
+		{
+			continue; // Didn't run this time, which is never slower.
+		}
+		const bool within_budget = found->second <= budget;
+		std::cout << (within_budget ? "ok   " : "FAIL ") << "stage " << stage << ": " << found->second << " s, budget " << budget << " s." << std::endl;
+		passed = passed && within_budget;
+	}
+
+	const double ceiling = xml_run.child("memory").attribute("peak_resident_bytes").as_double() * (1.0 + memory_tolerance);
+	const bool   within_ceiling = measured.peak_resident_bytes <= ceiling;
+	std::cout << (within_ceiling ? "ok   " : "FAIL ") << "peak resident memory: " << measured.peak_resident_bytes / (1 << 20) << " MiB, ceiling " << (uint64_t)ceiling / (1 << 20) << " MiB." << std::endl;
+	passed = passed && within_ceiling;
+
+	if (!passed)
+	{
+		std::cout << "Regression check failed. If the change is intended, rerun with VT_REGRESSION_UPDATE=1 to update " << golden_path << "." << std::endl;
+	}
+	return passed ? 0 : 1;
+}
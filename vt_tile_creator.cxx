@@ -6,9 +6,16 @@
  */
 
 #include <iostream>
+#include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
-#include <algorithm> // std::reverse
+#include <algorithm> // std::all_of, std::find_if
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
 #include <boost/regex.hpp>
@@ -18,7 +25,23 @@
 #include "RectangleBinPack/RectangleBinPack.h"
 
 #include "config.h"
+#include "atlas_regions.h"
+#include "atlas_report.h"
+#include "mipmap_resample.h"
+#include "build_journal.h"
+#include "build_manifest.h"
+#include "build_stats.h"
+#include "build_trace.h"
+#include "content_hash.h"
 #include "helper_functions.h"
+#include "image_header.h"
+#include "image_kernels.h"
+#include "subtexture_cache.h"
+#include "tile_pack.h"
+#include "tile_path.h"
+#include "tile_server.h"
+#include "tile_usage.h"
+#include "tile_writer.h"
 
 using namespace rbp;
 namespace po = boost::program_options;
@@ -30,9 +53,42 @@ unsigned int vt_tile_border_texels_wide;
 unsigned int vt_atlas_texels_wide;
 std::string  vt_atlas_file_format;
 std::string  vt_tile_file_format;
+std::string  vt_tile_container;
+std::string  vt_tile_layout_name;
+unsigned int vt_tile_shard_fan_out;
+std::string  vt_tile_codec_name;
+int          vt_tile_codec_level;
+unsigned int vt_tile_dictionary_bytes;
+unsigned int vt_tile_dictionary_sample_tiles;
+std::string  vt_tile_writer_backend_name;
+unsigned int vt_tile_writer_threads;
+unsigned int vt_tile_writer_in_flight_mib;
+unsigned int vt_tile_writer_batch_size;
+std::string  vt_input_list_path;
 std::string  output_path;
-
-// Global values.
+bool         vt_incremental;
+float        vt_repack_threshold;
+bool         vt_resume;
+std::string  vt_emit;
+std::string  vt_serve;
+unsigned int vt_serve_cache_mib;
+unsigned int vt_serve_threads;
+std::string  vt_tile_usage_path;
+float        vt_time_budget;
+std::string  vt_stats_json_path;
+std::string  vt_report_path;
+bool         vt_plan;
+unsigned int vt_tile_budget;
+std::string  vt_trace_path;
+bool         vt_perf_counters;
+std::string  vt_cache_path;
+unsigned int vt_cache_size_mib;
+
+std::string  vt_channels_name;
+std::string  vt_layers;
+bool         vt_interleave_layers;
+
+// Global values. Set from --channels.
 ILubyte vt_atlas_bpp    = 3;                // Bytes (not bits) per pixel, number of channels.
 ILenum  vt_atlas_format = IL_RGB;           // Channels are R, G, and B.
 ILenum  vt_atlas_type   = IL_UNSIGNED_BYTE; // One byte per colour channel.
@@ -42,12 +98,18 @@ struct subtexture
 {
 	size_t       m_index;
     std::string  m_original_file_name;
+	std::string  m_source_path;
+	uint64_t     m_content_hash = 0;
+	bool         m_loaded;       // False if reused from a previous build without decoding.
+	bool         m_bordered = false;
 	ilImage      m_image;
 	std::shared_ptr<RectangleBinPack::Node>
 		         m_atlas_node;
 	unsigned int m_texels_wide;
 	unsigned int m_texels_high;
 	unsigned int m_border_texels_wide = 0;
+	std::vector<std::string> m_extra_layer_paths; // Material layers after the first, with --layers. Same size and placement as m_image.
+	std::vector<ilImage>     m_extra_layers;
 
 	unsigned int top_left_texel_within_atlas_x() { return m_atlas_node->x; }
 	unsigned int top_left_texel_within_atlas_y() { return m_atlas_node->y; }
@@ -55,85 +117,127 @@ struct subtexture
 	unsigned int payload_top_left_texel_within_atlas_y() { return top_left_texel_within_atlas_y() + m_border_texels_wide; }
 	unsigned int payload_texels_wide() { return m_texels_wide - 2 * m_border_texels_wide; }
 	unsigned int payload_texels_high() { return m_texels_high - 2 * m_border_texels_wide; }
+	uint64_t     texel_bytes() { return (uint64_t)m_image.Width() * m_image.Height() * m_image.Bpp() * (1 + m_extra_layers.size()); }
+
+	// Decodes the other material layers. False if one of them isn't the size of the first.
+	bool load_extra_layers(const std::vector<std::string> &layer_paths)
+	{
+		m_extra_layer_paths = layer_paths;
+		for (const std::string &layer_path : layer_paths)
+		{
+			m_extra_layers.push_back(ilImage(layer_path.c_str()));
+			if (m_extra_layers.back().Width() != m_texels_wide || m_extra_layers.back().Height() != m_texels_high)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	ilImage &layer(const size_t &layer) { return layer == 0 ? m_image : m_extra_layers[layer - 1]; }
 
 	subtexture(const size_t &index, const boost::filesystem::path file_path) :
         m_index(index),
         m_original_file_name(file_path.filename().string()),
+		m_source_path(file_path.string()),
+		m_loaded(true),
 		m_image(ilImage(file_path.string().c_str())),
 		m_texels_wide(m_image.Width()),
 		m_texels_high(m_image.Height())
 	{}
 
-	// Calling add_inset_border multiple times will yield unpredictable results.
-	void add_inset_border(const unsigned int &border_texels_wide)
+	// Subtexture that a previous build already bordered and placed in the atlas. Its image is not decoded.
+	subtexture(const size_t &index, const boost::filesystem::path file_path, const manifest_subtexture &previous, const unsigned int &border_texels_wide) :
+		m_index(index),
+		m_original_file_name(file_path.filename().string()),
+		m_source_path(file_path.string()),
+		m_content_hash(previous.content_hash),
+		m_loaded(false),
+		m_texels_wide(previous.texels_wide),
+		m_texels_high(previous.texels_high),
+		m_border_texels_wide(border_texels_wide)
 	{
-		// Set border width.
-		m_border_texels_wide = border_texels_wide;
-
-		// Scale down current image (because border will be inset).
-		iluImageParameter(ILU_FILTER, ILU_BILINEAR); // Sufficient quality filter for downscaling according to DevIL docs. Sidenote: Couldn't find this function in DevIL C++ Wrapper.
-		m_image.Resize(m_texels_wide - 2*m_border_texels_wide, m_texels_high - 2*m_border_texels_wide, 1); // New size
+		place(previous.x, previous.y);
+	}
 
-		// Make temporal copy of scaled down image.
+	// Subtexture bordered before, by any build, and fetched from the subtexture cache instead of decoded.
+	subtexture(const size_t &index, const boost::filesystem::path file_path, cached_subtexture &cached) :
+		m_index(index),
+		m_original_file_name(file_path.filename().string()),
+		m_source_path(file_path.string()),
+		m_loaded(true),
+		m_bordered(true),
+		m_texels_wide(cached.texels_wide),
+		m_texels_high(cached.texels_high),
+		m_border_texels_wide(cached.border_texels_wide)
+	{
 		ilState::Enable(IL_ORIGIN_SET);
-		ilState::Origin(m_image.GetOrigin()); // Prevent image getting flipped vertically.
-		ilImage bordered_image;
-		//temp_image.Copy(m_image.GetId());
-		bordered_image.TexImage(m_texels_wide, m_texels_high, 1, vt_atlas_bpp, vt_atlas_format, vt_atlas_type, NULL);
-		bordered_image.Bind();
-		ilClearImage(); // Just to get rid off garbage values. Nice for debugging.
-		
-		// Copy the scaled down original image over leaving borders uncoloured for now.
-		ilOverlayImage(m_image.GetId(), m_border_texels_wide, m_border_texels_wide, 0);
-		// Note: original m_image is now no longer required.
-
-		// To add a border we will loop over all texels, 1 by 1, skipping the non-border texels, and copy byte values from the just copied image data.
-		ILubyte *bordered_image_bytes = bordered_image.GetData();
-
-		// Loop over texels left to right, top to bottom.
-		for (unsigned int y = 0; y < m_texels_high; y++)
-		{
-			for (unsigned int x = 0; x < m_texels_wide; x++)
-			{
-				// Now we'll act as if the non-border texels are their own image with its own coordinate system starting at its top left texel.
-				const int non_border_image_width  = m_texels_wide - 2 * m_border_texels_wide;
-				const int non_border_image_height = m_texels_high - 2 * m_border_texels_wide;
-
-				// Calculate corresponding non-border coordinates.
-				int non_border_x = x - m_border_texels_wide;
-				int non_border_y = y - m_border_texels_wide;
-
-				// If non_border_x and non_border_y are within the range of the non-border image, this texel was copied already.
-				if (non_border_x >= 0 && non_border_x < non_border_image_width && non_border_y >= 0 && non_border_y < non_border_image_height)
-				{
-					continue;
-				}
-				// If we've got this far, we've got a non-border coordinate outside of the non-border image, in other words: a border texel.
+		ilState::Origin(IL_ORIGIN_UPPER_LEFT); // Cached texels were stored top row first.
+		m_image.TexImage(m_texels_wide, m_texels_high, 1, (ILubyte)cached.bytes_per_texel, cached.format, cached.type, cached.texels.data());
+	}
 
-				// Wrap non_border_x and non_border_y and copy texel bytes and adjust back to border_image coordinates by adding border width.
-				const int wrapped_x = positive_modulo(non_border_x, non_border_image_width ) + m_border_texels_wide;
-				const int wrapped_y = positive_modulo(non_border_y, non_border_image_height) + m_border_texels_wide;
+	// Raw bordered texels, for storing in the subtexture cache.
+	cached_subtexture to_cache()
+	{
+		cached_subtexture cached;
+		cached.texels_wide        = m_texels_wide;
+		cached.texels_high        = m_texels_high;
+		cached.border_texels_wide = m_border_texels_wide;
+		cached.bytes_per_texel    = m_image.Bpp();
+		cached.format             = m_image.Format();
+		cached.type               = m_image.Type();
+		cached.texels.assign(m_image.GetData(), m_image.GetData() + (size_t)m_texels_wide * m_texels_high * cached.bytes_per_texel);
+		return cached;
+	}
 
-				// Translate the x and y coordinates into a one dimensional byte offset for bordered_image.
-				int byte_offset = (y * m_texels_wide + x) * vt_atlas_bpp;
+	// Where the subtexture came from and where it went, for the build manifest and journal.
+	manifest_subtexture to_manifest()
+	{
+		manifest_subtexture entry;
+		entry.name         = m_original_file_name;
+		entry.source_path  = m_source_path;
+		entry.content_hash = m_content_hash;
+		entry.x            = top_left_texel_within_atlas_x();
+		entry.y            = top_left_texel_within_atlas_y();
+		entry.texels_wide  = m_texels_wide;
+		entry.texels_high  = m_texels_high;
+		return entry;
+	}
 
-				// Now do the same for the imaginary non-border image.
-				int wrapped_byte_offset = (wrapped_y * m_texels_wide + wrapped_x) * vt_atlas_bpp;
-				
-				// Last is to loop over all texel bytes, copying from wrapped to non-wrapped.
-				for (int b = 0; b < vt_atlas_bpp; b++)
-				{
-					*(bordered_image_bytes + byte_offset + b) = *(bordered_image_bytes + wrapped_byte_offset + b);
-				}
-			}
-		}
+	// Puts the subtexture at a known spot in the atlas, bypassing RectangleBinPack.
+	void place(const unsigned int &x, const unsigned int &y)
+	{
+		m_atlas_node = std::make_shared<RectangleBinPack::Node>();
+		m_atlas_node->x      = (int)x;
+		m_atlas_node->y      = (int)y;
+		m_atlas_node->width  = (int)m_texels_wide;
+		m_atlas_node->height = (int)m_texels_high;
+	}
+
+	atlas_rectangle atlas_footprint()
+	{
+		atlas_rectangle footprint;
+		footprint.x      = top_left_texel_within_atlas_x();
+		footprint.y      = top_left_texel_within_atlas_y();
+		footprint.width  = m_texels_wide;
+		footprint.height = m_texels_high;
+		return footprint;
+	}
 
-		// The bordered image is now finished and ready to become the new m_image.
-		m_image = bordered_image;
+	// Calling add_inset_border multiple times will yield unpredictable results.
+	void add_inset_border(const unsigned int &border_texels_wide)
+	{
+		m_border_texels_wide = border_texels_wide;
+		::add_inset_border(m_image, m_border_texels_wide, { vt_atlas_bpp, vt_atlas_format, vt_atlas_type });
+		for (ilImage &extra_layer : m_extra_layers)
+		{
+			::add_inset_border(extra_layer, m_border_texels_wide, { vt_atlas_bpp, vt_atlas_format, vt_atlas_type });
+		}
+		m_bordered = true;
 	}
 
-	// Add subtexture to atlas using RectangleBinPack to find a spot and ilImage to copy subtexture data to.
-	void add_to_atlas(RectangleBinPack &atlas_bin, ilImage &atlas_image)
+	// Add subtexture to atlas using RectangleBinPack to find a spot and ilImage to copy subtexture data to, one per layer.
+	void add_to_atlas(RectangleBinPack &atlas_bin, std::vector<ilImage> &atlas_images)
 	{
 		m_atlas_node = atlas_bin.Insert(m_texels_wide, m_texels_high);
 		if (!m_atlas_node)
@@ -143,8 +247,16 @@ struct subtexture
 		}
 		else
 		{
-			atlas_image.Bind();
-			ilOverlayImage(m_image.GetId(), top_left_texel_within_atlas_x(), top_left_texel_within_atlas_y(), 0);
+			overlay_onto_atlas(atlas_images);
+		}
+	}
+
+	// Copy subtexture data to its spot in the atlas image of each layer.
+	void overlay_onto_atlas(std::vector<ilImage> &atlas_images)
+	{
+		for (size_t l = 0; l < atlas_images.size(); l++)
+		{
+			overlay_image(atlas_images[l], layer(l), top_left_texel_within_atlas_x(), top_left_texel_within_atlas_y());
 		}
 	}
 };
@@ -158,6 +270,10 @@ std::string regex_escape(const std::string& string_to_escape) {
 
 int main(int argc, char *argv[])
 {
+	const std::chrono::steady_clock::time_point build_start = std::chrono::steady_clock::now();
+	build_stats pipeline_stats;
+	memory_sampler resident_memory_sampler(std::chrono::milliseconds(10));
+
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// Parse command line options.
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -172,7 +288,8 @@ int main(int argc, char *argv[])
 	po::options_description config("Configuration");
 	config.add_options()
 		("subtexture-files,i", po::value< std::vector<std::string> >(), "specifies texture files to virtualise")
-		("output-path,o", po::value< std::string >(&output_path)->default_value(boost::filesystem::current_path().string() + "\\" + current_timestamp()), "path to write files to")
+		("input-list", po::value< std::string >(&vt_input_list_path)->default_value(""), "file listing texture files to virtualise, one per line, relative to the list itself")
+		("output-path,o", po::value< std::string >(&output_path)->default_value((boost::filesystem::current_path() / current_timestamp()).string()), "path to write files to")
 
 		("wrap-border-width", po::value<unsigned int>(&vt_subtexture_border_texels_wide)->default_value(std::atoi(VT_SUBTEXTURE_BORDER_TEXELS_WIDE)), "subtexture wrapping border width in texels")
 		("atlas-width", po::value<unsigned int>(&vt_atlas_texels_wide)->default_value(std::atoi(VT_ATLAS_TEXELS_WIDE)), "atlas width (and height) in texels")
@@ -181,6 +298,37 @@ int main(int argc, char *argv[])
 		("tile-width", po::value<unsigned int>(&vt_tile_texels_wide)->default_value(std::atoi(VT_TILE_TEXELS_WIDE)), "tile width (and height) in texels")
 		("tile-border-width", po::value<unsigned int>(&vt_tile_border_texels_wide)->default_value(std::atoi(VT_TILE_BORDER_TEXELS_WIDE)), "tile border width in texels")
 		("tile-format", po::value< std::string >(&vt_tile_file_format)->default_value(VT_TILE_FORMAT), "extension to use for tile image files")
+		("layers", po::value< std::string >(&vt_layers)->default_value(""), "names of material layers sharing one packing, like albedo,normal,roughness. Each subtexture then names one file per layer, separated by |")
+		("interleave-layers", po::bool_switch(&vt_interleave_layers), "store the same tile of all layers together in one tile pack record, so a page of all layers is one read and one decode")
+		("channels", po::value< std::string >(&vt_channels_name)->default_value(VT_CHANNELS), "channel layout of atlas, mipmaps and tiles: r, rg, rgb or rgba")
+		("emit", po::value< std::string >(&vt_emit)->default_value("all"), "intermediate images to save besides tiles and xml: all, none, or any of borders,atlas,mipmaps")
+		("tile-container", po::value< std::string >(&vt_tile_container)->default_value(VT_TILE_CONTAINER), "files (one image file per tile) or pack (one tile pack of compressed raw tiles)")
+		("tile-layout", po::value< std::string >(&vt_tile_layout_name)->default_value("flat"), "directory layout of tile files: flat or sharded (mipID/x_bucket/)")
+		("tile-shard-fan-out", po::value<unsigned int>(&vt_tile_shard_fan_out)->default_value(16), "tile columns per x_bucket directory of the sharded tile layout")
+		("tile-codec", po::value< std::string >(&vt_tile_codec_name)->default_value(VT_TILE_CODEC), "codec for tiles in a tile pack: raw, lz4 or zstd")
+		("tile-codec-level", po::value<int>(&vt_tile_codec_level)->default_value(3), "zstd compression level, or lz4 acceleration factor")
+		("tile-dictionary-size", po::value<unsigned int>(&vt_tile_dictionary_bytes)->default_value(112640), "bytes of codec dictionary to train on this run's tiles, 0 for none")
+		("tile-dictionary-samples", po::value<unsigned int>(&vt_tile_dictionary_sample_tiles)->default_value(256), "number of tiles to train the codec dictionary on")
+		("tile-writer", po::value< std::string >(&vt_tile_writer_backend_name)->default_value("auto"), "how to write tile files: auto, uring (Linux io_uring), threads or sync")
+		("tile-writer-threads", po::value<unsigned int>(&vt_tile_writer_threads)->default_value(4), "number of threads for the threads tile writer")
+		("tile-writer-in-flight", po::value<unsigned int>(&vt_tile_writer_in_flight_mib)->default_value(256), "maximum MiB of encoded tiles waiting to be written")
+		("tile-writer-batch", po::value<unsigned int>(&vt_tile_writer_batch_size)->default_value(32), "number of tile files submitted to io_uring at once")
+		("incremental", po::bool_switch(&vt_incremental), "build upon a previous build in the output path, redoing only what changed")
+		("resume", po::bool_switch(&vt_resume), "continue a build in the output path that was cut short, skipping the stages and tile rows it finished")
+		("repack-threshold", po::value<float>(&vt_repack_threshold)->default_value(0.75f), "atlas free space fragmentation (0 to 1) past which an incremental build repacks all subtextures")
+		("cache-path", po::value< std::string >(&vt_cache_path)->default_value(""), "directory of a cache of bordered subtextures, may be shared between builds")
+		("serve", po::value< std::string >(&vt_serve)->default_value(""), "instead of writing tiles, serve them over HTTP on [address:]port or unix:socket_path, generating each on first request")
+		("serve-cache-size", po::value<unsigned int>(&vt_serve_cache_mib)->default_value(1024), "maximum MiB of encoded tiles the tile server keeps in memory")
+		("serve-threads", po::value<unsigned int>(&vt_serve_threads)->default_value(4), "number of threads answering tile server requests")
+		("tile-usage", po::value< std::string >(&vt_tile_usage_path)->default_value(""), "tile usage histogram from renderer feedback, lines of mipID x y [count], to generate the most used tiles first")
+		("time-budget", po::value<float>(&vt_time_budget)->default_value(0.0f), "seconds after which to stop generating tiles and record which are missing, 0 for no limit")
+		("stats-json", po::value< std::string >(&vt_stats_json_path)->default_value(""), "file to write wall and CPU time, items and bytes per build stage to, as JSON")
+		("plan", po::bool_switch(&vt_plan), "only read image headers, pack the atlas and estimate tiles, peak memory and output size of a full build, then exit")
+		("tile-budget", po::value<unsigned int>(&vt_tile_budget)->default_value(0), "maximum number of tiles with content --plan accepts, 0 for no limit")
+		("report", po::value< std::string >(&vt_report_path)->default_value(""), "file to write atlas occupancy, empty tiles per mip level, tiles per subtexture and projected output size to, as JSON")
+		("trace", po::value< std::string >(&vt_trace_path)->default_value(""), "file to write a trace of all work per thread to, for chrome://tracing or Perfetto")
+		("perf-counters", po::bool_switch(&vt_perf_counters), "count cycles, instructions, cache misses and branch misses per stage (Linux perf_event_open)")
+		("cache-size", po::value<unsigned int>(&vt_cache_size_mib)->default_value(4096), "maximum MiB in the subtexture cache before least recently used entries are evicted")
 		;
 
 	// Options allowed in both, but hidden from help.
@@ -220,6 +368,133 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	// Every image from bordering onwards has the same channel layout. Masks needn't take up three bytes per texel.
+	texel_layout vt_atlas_layout;
+	if (!texel_layout_from_string(vt_channels_name, vt_atlas_layout))
+	{
+		std::cout << "Unknown channel layout " << vt_channels_name << ". Use r, rg, rgb or rgba. Exiting..." << std::endl;
+		return 1;
+	}
+	vt_atlas_bpp    = vt_atlas_layout.bytes_per_texel;
+	vt_atlas_format = vt_atlas_layout.format;
+	vt_atlas_type   = vt_atlas_layout.type;
+
+	// Material layers share the packing, so each gets its own atlas, mipmaps and tiles from the same placements.
+	std::vector<std::string> layer_names;
+	if (!vt_layers.empty())
+	{
+		boost::split(layer_names, vt_layers, boost::is_any_of(","));
+		for (size_t l = 0; l < layer_names.size(); l++)
+		{
+			if (layer_names[l].empty() || std::find(layer_names.begin(), layer_names.begin() + l, layer_names[l]) != layer_names.begin() + l)
+			{
+				std::cout << "Layer names should be unique and not empty. Exiting..." << std::endl;
+				return 1;
+			}
+		}
+	}
+	const bool   layered     = !layer_names.empty();
+	const size_t layer_count = layered ? layer_names.size() : 1;
+	auto layer_file_name = [&](const std::string &stem, const std::string &extension, const size_t &layer) {
+		return stem + (layered ? "_" + layer_names[layer] : "") + extension;
+	};
+	if (layered && !vt_serve.empty())
+	{
+		std::cout << "Serving tiles of more than one layer isn't supported. Exiting..." << std::endl;
+		return 1;
+	}
+
+	// Check tile container settings before any heavy lifting is done.
+	tile_codec vt_tile_codec = tile_codec::raw;
+	if (vt_tile_container != "files" && vt_tile_container != "pack")
+	{
+		std::cout << "Unknown tile container " << vt_tile_container << ". Use files or pack. Exiting..." << std::endl;
+		return 1;
+	}
+	if (vt_interleave_layers && (!layered || vt_tile_container != "pack"))
+	{
+		std::cout << "Interleaving layers needs --layers and --tile-container pack. Exiting..." << std::endl;
+		return 1;
+	}
+	if (vt_tile_container == "pack")
+	{
+		if (!tile_codec_from_string(vt_tile_codec_name, vt_tile_codec))
+		{
+			std::cout << "Unknown tile codec " << vt_tile_codec_name << ". Use raw, lz4 or zstd. Exiting..." << std::endl;
+			return 1;
+		}
+		if (!tile_codec_available(vt_tile_codec))
+		{
+			std::cout << "Tile codec " << vt_tile_codec_name << " was not available when vtTileCreator was built. Exiting..." << std::endl;
+			return 1;
+		}
+	}
+	tile_layout vt_tile_layout = tile_layout::flat;
+	if (!tile_layout_from_string(vt_tile_layout_name, vt_tile_layout))
+	{
+		std::cout << "Unknown tile layout " << vt_tile_layout_name << ". Use flat or sharded. Exiting..." << std::endl;
+		return 1;
+	}
+	// Intermediate images are nice for debugging, but encoding them can take longer than cutting all tiles.
+	bool emit_borders = vt_emit == "all";
+	bool emit_atlas   = vt_emit == "all";
+	bool emit_mipmaps = vt_emit == "all";
+	if (vt_emit != "all" && vt_emit != "none")
+	{
+		std::vector<std::string> emitted;
+		boost::split(emitted, vt_emit, boost::is_any_of(","));
+		for (const std::string &intermediate : emitted)
+		{
+			if      (intermediate == "borders") emit_borders = true;
+			else if (intermediate == "atlas")   emit_atlas   = true;
+			else if (intermediate == "mipmaps") emit_mipmaps = true;
+			else
+			{
+				std::cout << "Unknown intermediate image " << intermediate << " to emit. Use all, none, or any of borders,atlas,mipmaps. Exiting..." << std::endl;
+				return 1;
+			}
+		}
+	}
+	const std::string emitted_intermediates = std::string(emit_borders ? "b" : "") + (emit_atlas ? "a" : "") + (emit_mipmaps ? "m" : "");
+
+	tile_writer_backend vt_tile_writer_backend = tile_writer_backend::sync;
+	if (!tile_writer_backend_from_string(vt_tile_writer_backend_name, vt_tile_writer_backend))
+	{
+		std::cout << "Unknown tile writer " << vt_tile_writer_backend_name << ". Use auto, uring, threads or sync. Exiting..." << std::endl;
+		return 1;
+	}
+	if (!tile_writer_backend_available(vt_tile_writer_backend))
+	{
+		std::cout << "Tile writer " << vt_tile_writer_backend_name << " was not available when vtTileCreator was built. Exiting..." << std::endl;
+		return 1;
+	}
+	if (vt_perf_counters)
+	{
+		// Not being allowed to count is no reason not to build.
+		std::string error;
+		const bool counting = perf_counters_start(error);
+		if (!error.empty())
+		{
+			std::cout << error << ". " << (counting ? "Counting the rest." : "Carrying on without hardware counters.") << std::endl;
+		}
+	}
+	if (!vt_trace_path.empty())
+	{
+		trace_start();
+		trace_thread_name("main");
+	}
+	tile_usage_histogram tile_usage;
+	if (!vt_tile_usage_path.empty())
+	{
+		std::string error;
+		if (!tile_usage.load(vt_tile_usage_path, error))
+		{
+			std::cout << error << ". Exiting..." << std::endl;
+			return 1;
+		}
+		tile_usage.add_to_coarser_tiles();
+	}
+
 
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// Step 0: Prepare running the full program.
@@ -237,20 +512,92 @@ int main(int argc, char *argv[])
 	std::vector<std::string> subtexture_paths;
 	std::vector<subtexture> subtextures;
 	
+	// Gather filenames from the command line and the input list.
+	std::vector<std::string> input_paths;
+	if (po_variables.count("subtexture-files"))
+	{
+		input_paths = po_variables["subtexture-files"].as<std::vector<std::string>>();
+	}
+	if (!vt_input_list_path.empty())
+	{
+		std::ifstream input_list(vt_input_list_path);
+		if (!input_list)
+		{
+			std::cout << "Couldn't open input list " << vt_input_list_path << ". Exiting..." << std::endl;
+			return 1;
+		}
+		const boost::filesystem::path input_list_folder = boost::filesystem::absolute(vt_input_list_path).parent_path();
+		std::string line;
+		while (std::getline(input_list, line))
+		{
+			boost::trim(line);
+			if (line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+			std::vector<std::string> listed_layers;
+			boost::split(listed_layers, line, boost::is_any_of(layered ? "|" : ""));
+			for (std::string &listed_layer : listed_layers)
+			{
+				boost::trim(listed_layer);
+				const boost::filesystem::path listed_path(listed_layer);
+				listed_layer = (listed_path.is_relative() ? input_list_folder / listed_path : listed_path).string();
+			}
+			input_paths.push_back(boost::algorithm::join(listed_layers, "|"));
+		}
+	}
+
 	// Check if filenames were given.
-	if (po_variables.count("subtexture-files") < 1)
+	if (input_paths.empty())
 	{
 		std::cout << "No filenames were given to create atlas and tiles from. Exiting..." << std::endl;
 		return 1;
 	}
 	
-	// Go over command line input, adding existing paths to subtexture_paths vector.
-	for (std::string subtexture_path : po_variables["subtexture-files"].as<std::vector<std::string>>())
+	// Go over input, adding existing paths to subtexture_paths vector.
+	std::vector<std::vector<std::string>> subtexture_layer_paths; // Per subtexture, the files of layers after the first.
+	for (std::string subtexture_path : input_paths)
 	{
+		// Layered entries name every file in full.
+		if (layered)
+		{
+			std::vector<std::string> layer_paths;
+			boost::split(layer_paths, subtexture_path, boost::is_any_of("|"));
+			if (layer_paths.size() != layer_count)
+			{
+				std::cout << "Subtexture " << subtexture_path << " names " << layer_paths.size() << " layer files rather than " << layer_count << ". Exiting..." << std::endl;
+				return 1;
+			}
+			for (std::string &layer_path : layer_paths)
+			{
+				boost::trim(layer_path);
+				boost::filesystem::path layer_file_path(layer_path);
+				layer_path = (layer_file_path.is_relative() ? boost::filesystem::current_path() / layer_file_path : layer_file_path).string();
+				if (!boost::filesystem::is_regular_file(layer_path))
+				{
+					std::cout << "Layer file " << layer_path << " doesn't exist. Wildcards aren't supported with --layers. Exiting..." << std::endl;
+					return 1;
+				}
+			}
+			subtexture_paths.push_back(layer_paths.front());
+			subtexture_layer_paths.push_back(std::vector<std::string>(layer_paths.begin() + 1, layer_paths.end()));
+			continue;
+		}
+
 		boost::filesystem::path file_path(subtexture_path);
 		if (file_path.is_relative())
 		{
-			file_path = boost::filesystem::current_path().string() + "\\" + file_path.string();
+			file_path = boost::filesystem::current_path() / file_path;
+		}
+
+		// Plain file names needn't go over the whole directory, which adds up with thousands of files from an input list.
+		if (file_path.filename().string().find('*') == std::string::npos)
+		{
+			if (boost::filesystem::is_regular_file(file_path))
+			{
+				subtexture_paths.push_back(file_path.string());
+			}
+			continue;
 		}
 			
 		// Support for wildcards is very convenient when working with many files as input. I use regex for this.
@@ -296,6 +643,8 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	subtexture_layer_paths.resize(subtexture_paths.size());
+
 	// For clean output, determine the length of the longest file name.
 	unsigned int length_longest_filename = 0;
 	for (boost::filesystem::path subtexture_path : subtexture_paths)
@@ -307,16 +656,399 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	// Go over subtexture_paths vector, creating a subtexture for each.
+	// Everything that influences the output. A previous build is only built upon if all of these match.
+	const std::map<std::string, std::string> build_parameters = {
+		{ "wrap_border_width",  std::to_string(vt_subtexture_border_texels_wide) },
+		{ "atlas_width",        std::to_string(vt_atlas_texels_wide) },
+		{ "atlas_format",       vt_atlas_file_format },
+		{ "tile_width",         std::to_string(vt_tile_texels_wide) },
+		{ "tile_border_width",  std::to_string(vt_tile_border_texels_wide) },
+		{ "tile_format",        vt_tile_file_format },
+		{ "channels",           std::to_string(vt_atlas_bpp) },
+		{ "layers",             vt_layers },
+		{ "interleave_layers",  vt_interleave_layers ? "1" : "0" },
+		{ "tile_container",     vt_tile_container },
+		{ "tile_layout",        vt_tile_layout_name },
+		{ "tile_shard_fan_out", std::to_string(vt_tile_shard_fan_out) },
+		{ "emit",               emitted_intermediates }, // Whatever is on disk of other intermediates wasn't written by this build.
+	};
+
+	// Timings and traces are saved on the way out, also when a build finishes early.
+	auto save_build_stats = [&]() {
+		const memory_peak peak_devil    = pipeline_stats.peak_devil();
+		const memory_peak peak_resident = pipeline_stats.peak_resident();
+		std::cout << "Peak memory: " << std::max(peak_resident.bytes, peak_resident_bytes()) / (1 << 20) << " MiB resident"
+			<< (peak_resident.stage.empty() ? "" : " (" + peak_resident.stage + ")") << ", "
+			<< peak_devil.bytes / (1 << 20) << " MiB of DevIL images" << (peak_devil.stage.empty() ? "" : " (" + peak_devil.stage + ")") << "." << std::endl;
+		for (const stage_stats &stage : pipeline_stats.stages())
+		{
+			std::cout << " - " << lead_blanks(stage.name, 8) << ": " << stage.peak_resident_bytes / (1 << 20) << " MiB resident, " << stage.peak_devil_bytes / (1 << 20) << " MiB of DevIL images." << std::endl;
+		}
+		if (perf_counters_enabled())
+		{
+			std::cout << "Hardware counters:" << std::endl;
+			for (const stage_stats &stage : pipeline_stats.stages())
+			{
+				if (stage.perf.counted)
+				{
+					std::cout << " - " << lead_blanks(stage.name, 8) << ": " << perf_counts_summary(stage.perf) << "." << std::endl;
+				}
+			}
+		}
+		if (!vt_stats_json_path.empty())
+		{
+			const bool saved = pipeline_stats.save_json(vt_stats_json_path, build_parameters);
+			std::cout << (saved ? "Saved build stats " : "Couldn't save build stats ") << vt_stats_json_path << "." << std::endl;
+		}
+		if (!vt_trace_path.empty())
+		{
+			const bool saved = trace_save(vt_trace_path);
+			std::cout << (saved ? "Saved build trace " : "Couldn't save build trace ") << vt_trace_path << "." << std::endl;
+		}
+	};
+
+	// Planning: Work out what a full build would take from image dimensions alone, without writing anything but the report.
+	if (vt_plan)
+	{
+		RectangleBinPack plan_bin_pack;
+		plan_bin_pack.Init((int)vt_atlas_texels_wide, (int)vt_atlas_texels_wide);
+		atlas_report report(vt_atlas_texels_wide, vt_tile_texels_wide, vt_tile_border_texels_wide, vt_atlas_bpp);
+		auto read_dimensions = [&pipeline_stats](const boost::filesystem::path &file_path, image_header &header) {
+			stage_timer timer(pipeline_stats, "header");
+			timer.detail = file_path.filename().string();
+			if (!read_image_header(file_path.string(), header))
+			{
+				// Not a format I can read the header of. Decoding it is slow, but still right.
+				ilImage image(file_path.string().c_str());
+				header.texels_wide = image.Width();
+				header.texels_high = image.Height();
+			}
+			return header.texels_wide > 0 && header.texels_high > 0;
+		};
+		uint64_t subtexture_bytes = 0;
+		for (size_t i = 0; i < subtexture_paths.size(); i++)
+		{
+			const boost::filesystem::path subtexture_path = subtexture_paths[i];
+			image_header header;
+			if (!read_dimensions(subtexture_path, header))
+			{
+				std::cout << "Couldn't read subtexture " << subtexture_path.string() << ". Exiting..." << std::endl;
+				return 1;
+			}
+			for (const std::string &layer_path : subtexture_layer_paths[i])
+			{
+				image_header layer_header;
+				if (!read_dimensions(layer_path, layer_header) || layer_header.texels_wide != header.texels_wide || layer_header.texels_high != header.texels_high)
+				{
+					std::cout << "Layer file " << layer_path << " isn't the size of " << subtexture_path.string() << ". Exiting..." << std::endl;
+					return 1;
+				}
+			}
+
+			std::shared_ptr<RectangleBinPack::Node> node;
+			{
+				stage_timer timer(pipeline_stats, "pack");
+				node = plan_bin_pack.Insert(header.texels_wide, header.texels_high);
+			}
+			if (!node)
+			{
+				std::cout << "Subtexture " << subtexture_path.filename().string() << " (" << header.texels_wide << " * " << header.texels_high << " texels) doesn't fit in the atlas. Exiting..." << std::endl;
+				return 1;
+			}
+			atlas_rectangle footprint;
+			footprint.x      = (unsigned int)node->x;
+			footprint.y      = (unsigned int)node->y;
+			footprint.width  = header.texels_wide;
+			footprint.height = header.texels_high;
+			report.add_subtexture(subtexture_path.filename().string(), footprint);
+			subtexture_bytes += (uint64_t)header.texels_wide * header.texels_high * vt_atlas_bpp * layer_count;
+		}
+		report.set_occupancy(plan_bin_pack.Occupancy());
+		report.finish();
+
+		// All subtextures, the atlas and all of its mipmap levels are in memory by the time tiles are cut, on top of the tile files in flight.
+		// Resampling the finest level from the atlas takes the most scratch memory of all levels.
+		const uint64_t atlas_bytes = (uint64_t)vt_atlas_texels_wide * vt_atlas_texels_wide * vt_atlas_bpp * layer_count;
+		uint64_t mipmap_bytes = 0;
+		uint64_t resample_bytes = 0;
+		for (const mip_level_report &level : report.levels())
+		{
+			mipmap_bytes += (uint64_t)level.texels_wide * level.texels_wide * vt_atlas_bpp * layer_count;
+			resample_bytes = std::max<uint64_t>(resample_bytes, resample_scratch_bytes(vt_atlas_texels_wide, level.texels_wide, level.texels_wide, vt_atlas_bpp));
+		}
+		const uint64_t tile_output_bytes = report.tiles() * vt_tile_texels_wide * vt_tile_texels_wide * vt_atlas_bpp * layer_count;
+		const uint64_t in_flight_bytes   = vt_tile_container == "files" ? std::min(tile_output_bytes, (uint64_t)vt_tile_writer_in_flight_mib << 20) : 0;
+		report.add_estimate("peak_memory", subtexture_bytes + atlas_bytes + mipmap_bytes + std::max(resample_bytes, in_flight_bytes));
+		report.add_estimate("intermediate_output", (emit_borders ? subtexture_bytes : 0) + (emit_atlas ? atlas_bytes : 0) + (emit_mipmaps ? mipmap_bytes : 0));
+
+		std::cout << "Planned a full build of " << subtexture_paths.size() << " subtextures. Sizes are uncompressed" << (layered ? ", tile sizes per layer." : ".") << std::endl;
+		report.print(std::cout);
+		if (!vt_report_path.empty())
+		{
+			const bool saved = report.save_json(vt_report_path);
+			std::cout << (saved ? "Saved atlas report " : "Couldn't save atlas report ") << vt_report_path << "." << std::endl;
+		}
+		save_build_stats();
+
+		const uint64_t content_tiles = report.tiles() - report.empty_tiles();
+		if (vt_tile_budget > 0 && content_tiles > vt_tile_budget)
+		{
+			std::cout << "Planned " << content_tiles << " tiles with content, over the tile budget of " << vt_tile_budget << ". Exiting..." << std::endl;
+			return 1;
+		}
+		std::cout << "Bye bye." << std::endl;
+		return 0;
+	}
+
+	// See whether a previous build in the output directory can be built upon.
+	const std::string build_manifest_file_path = (boost::filesystem::path(output_path) / "build_manifest.xml").string();
+	const std::string atlas_file_path          = (boost::filesystem::path(output_path) / "1b_atlas" / ("atlas" + vt_atlas_file_format)).string();
+	build_manifest previous_build;
+	bool incremental = false;
+	if (vt_incremental)
+	{
+		std::string atlas_file_extension = vt_atlas_file_format;
+		std::transform(atlas_file_extension.begin(), atlas_file_extension.end(), atlas_file_extension.begin(), ::tolower);
+		if (layered)
+		{
+			std::cout << "Incremental builds don't support --layers yet. Doing a full build." << std::endl;
+		}
+		else if (!previous_build.load(build_manifest_file_path))
+		{
+			std::cout << "No build manifest found in output path. Doing a full build." << std::endl;
+		}
+		else if (previous_build.parameters != build_parameters)
+		{
+			std::cout << "Parameters differ from the previous build. Doing a full build." << std::endl;
+		}
+		else if (!emit_atlas || !emit_mipmaps)
+		{
+			std::cout << "Incremental builds need --emit to include atlas and mipmaps. Doing a full build." << std::endl;
+		}
+		else if (vt_tile_container != "files")
+		{
+			std::cout << "Incremental builds need --tile-container files. Doing a full build." << std::endl;
+		}
+		else if (atlas_file_extension == ".jpg" || atlas_file_extension == ".jpeg")
+		{
+			std::cout << "Incremental builds need a lossless atlas format. Doing a full build." << std::endl;
+		}
+		else if (!boost::filesystem::exists(atlas_file_path))
+		{
+			std::cout << "Atlas of the previous build is missing. Doing a full build." << std::endl;
+		}
+		else
+		{
+			incremental = true;
+		}
+	}
+
+	// Hash all subtextures up front. Whether anything changed is known before decoding a thing.
+	std::vector<uint64_t> content_hashes;
+	std::vector<std::pair<std::string, uint64_t>> build_inputs;
 	for (boost::filesystem::path subtexture_path : subtexture_paths)
 	{
+		stage_timer timer(pipeline_stats, "hash");
+		timer.detail = subtexture_path.filename().string();
+		boost::system::error_code ignored;
+		timer.bytes_in = boost::filesystem::file_size(subtexture_path, ignored);
+		uint64_t content_hash = 0;
+		if (!hash_file(subtexture_path.string(), content_hash))
+		{
+			std::cout << "Couldn't read subtexture " << subtexture_path.string() << ". Exiting..." << std::endl;
+			return 1;
+		}
+		content_hashes.push_back(content_hash);
+		build_inputs.push_back({ subtexture_path.filename().string(), content_hash });
+	}
+
+	// See whether a build that was cut short in the output directory can be continued.
+	const std::string build_journal_file_path = (boost::filesystem::path(output_path) / "build_journal.txt").string();
+	const uint64_t    current_build_key       = build_key(build_parameters, build_inputs);
+	build_journal journal;
+	bool resuming = false;
+	if (vt_resume)
+	{
+		if (layered)
+		{
+			std::cout << "Resuming doesn't support --layers yet. Starting from scratch." << std::endl;
+		}
+		else if (!journal.load(build_journal_file_path))
+		{
+			std::cout << "No build journal found in output path. Starting from scratch." << std::endl;
+		}
+		else if (journal.build_key() != current_build_key)
+		{
+			std::cout << "Parameters or subtextures differ from the journaled build. Starting from scratch." << std::endl;
+		}
+		else
+		{
+			std::cout << "Resuming the journaled build." << std::endl;
+			resuming = true;
+			incremental = false; // Whatever the interrupted build was, what it left behind is finished as a full build.
+		}
+	}
+
+	// Sources bordered before don't need decoding nor bordering. Checked by content hash, before decoding.
+	// Only the first layer would fit in the cache, so layered builds do without.
+	if (layered && !vt_cache_path.empty())
+	{
+		std::cout << "The subtexture cache doesn't support --layers yet. Carrying on without it." << std::endl;
+	}
+	subtexture_cache bordered_subtexture_cache(layered ? std::string() : vt_cache_path, (uint64_t)vt_cache_size_mib << 20);
+	auto cache_key = [](const uint64_t &content_hash) {
+		return subtexture_cache::key(content_hash, vt_subtexture_border_texels_wide, vt_atlas_format, vt_atlas_type, vt_atlas_bpp);
+	};
+	auto load_subtexture = [&](const size_t &index, const boost::filesystem::path &subtexture_path, const uint64_t &content_hash) {
+		stage_timer timer(pipeline_stats, "load");
+		timer.detail = subtexture_path.filename().string();
+		cached_subtexture cached;
+		if (bordered_subtexture_cache.load(cache_key(content_hash), cached))
+		{
+			subtexture texture(index, subtexture_path, cached);
+			texture.m_content_hash = content_hash;
+			timer.bytes_in = timer.bytes_out = texture.texel_bytes();
+			return texture;
+		}
+		boost::system::error_code ignored;
+		timer.bytes_in = boost::filesystem::file_size(subtexture_path, ignored);
+		subtexture texture(index, subtexture_path);
+		texture.m_content_hash = content_hash;
+		timer.bytes_out = texture.texel_bytes();
+		return texture;
+	};
+
+	// Go over subtexture_paths vector, creating a subtexture for each.
+	// When building upon a previous build, subtextures whose content didn't change are not even decoded.
+	// The same goes for subtextures a resumed build placed in the atlas already.
+	std::vector<atlas_rectangle> dirty_atlas_rectangles;
+	const bool resuming_atlas = resuming && journal.stage_completed("atlas");
+	for (size_t i = 0; i < subtexture_paths.size(); i++)
+	{
+		const boost::filesystem::path subtexture_path = subtexture_paths[i];
+		const uint64_t content_hash = content_hashes[i];
+
+		const manifest_subtexture *previous = incremental ? previous_build.find(subtexture_path.filename().string()) : (resuming_atlas ? journal.find_placement(subtexture_path.filename().string()) : nullptr);
+		if (previous && previous->content_hash == content_hash)
+		{
+			subtextures.push_back(subtexture(subtextures.size(), subtexture_path, *previous, vt_subtexture_border_texels_wide));
+			std::cout << " - Reused subtexture " << lead_blanks(subtexture_path.filename().string(), length_longest_filename) << (incremental ? " from previous build." : " from interrupted build.") << std::endl;
+			continue;
+		}
+
 		// Assumed here is that all arguments are correct paths to textures.
-		subtexture texture = subtexture(subtextures.size(), subtexture_path);
+		subtexture texture = load_subtexture(subtextures.size(), subtexture_path, content_hash);
+		if (!texture.load_extra_layers(subtexture_layer_paths[i]))
+		{
+			std::cout << "Not all layers of subtexture " << subtexture_path.string() << " are the same size. Exiting..." << std::endl;
+			return 1;
+		}
+		std::cout << (texture.m_bordered ? " - Cached subtexture " : " - Loaded subtexture ") << lead_blanks(subtexture_path.filename().string(), length_longest_filename) << ", " << lead_blanks(texture.m_texels_wide, 4) << " * " << lead_blanks(texture.m_texels_high, 4) << " texels, " << (int)texture.m_image.Bpp() << " bpp, format: " << texture.m_image.Format() << ", type: " << texture.m_image.Type() << "." << std::endl;
+
+		// A changed subtexture can take the place of its previous version, as long as it still fits exactly.
+		// New and resized ones get a spot in the free space later on.
+		if (incremental && previous && previous->texels_wide == texture.m_texels_wide && previous->texels_high == texture.m_texels_high)
+		{
+			texture.place(previous->x, previous->y);
+			dirty_atlas_rectangles.push_back(texture.atlas_footprint());
+		}
 		subtextures.push_back(texture);
-		std::cout << " - Loaded subtexture " << lead_blanks(subtexture_path.filename().string(), length_longest_filename) << ", " << lead_blanks(texture.m_texels_wide, 4) << " * " << lead_blanks(texture.m_texels_high, 4) << " texels, " << (int)texture.m_image.Bpp() << " bpp, format: " << texture.m_image.Format() << ", type: " << texture.m_image.Type() << "." << std::endl;
+	}
+
+	// Subtextures that were part of the previous build, but no longer are or changed size, leave a hole to clear.
+	std::vector<atlas_rectangle> removed_atlas_rectangles;
+	if (incremental)
+	{
+		for (const manifest_subtexture &previous : previous_build.subtextures)
+		{
+			const auto current = std::find_if(subtextures.begin(), subtextures.end(), [&previous](const subtexture &texture) { return texture.m_original_file_name == previous.name; });
+			if (current == subtextures.end() || !current->m_atlas_node)
+			{
+				atlas_rectangle footprint;
+				footprint.x      = previous.x;
+				footprint.y      = previous.y;
+				footprint.width  = previous.texels_wide;
+				footprint.height = previous.texels_high;
+				removed_atlas_rectangles.push_back(footprint);
+				dirty_atlas_rectangles.push_back(footprint);
+				std::cout << (current == subtextures.end() ? " - Removed subtexture " : " - Resized subtexture ") << previous.name << " since previous build." << std::endl;
+			}
+		}
+	}
+
+	// Keep everything that didn't move where it was, by seeding the atlas bin with those placements as used space,
+	// and fit new and resized subtextures into what's left. A full repack only happens if they don't fit, or if the
+	// free space got too scattered to be of much use to future builds.
+	RectangleBinPack atlas_rectangle_bin_pack;
+	atlas_rectangle_bin_pack.Init((int)vt_atlas_texels_wide, (int)vt_atlas_texels_wide);
+	std::unique_ptr<stage_timer> packing_timer(new stage_timer(pipeline_stats, "pack", 0));
+	if (incremental)
+	{
+		for (subtexture &texture : subtextures)
+		{
+			if (texture.m_atlas_node && !atlas_rectangle_bin_pack.Reserve(texture.m_atlas_node->x, texture.m_atlas_node->y, texture.m_texels_wide, texture.m_texels_high))
+			{
+				std::cout << "Placement of subtexture " << texture.m_original_file_name << " in previous build overlaps another. Doing a full build." << std::endl;
+				incremental = false;
+				break;
+			}
+		}
+	}
+	if (incremental)
+	{
+		for (subtexture &texture : subtextures)
+		{
+			if (texture.m_atlas_node)
+			{
+				continue;
+			}
+			trace_scope span("place", texture.m_original_file_name);
+			texture.m_atlas_node = atlas_rectangle_bin_pack.Insert(texture.m_texels_wide, texture.m_texels_high);
+			if (!texture.m_atlas_node)
+			{
+				std::cout << "Subtexture " << texture.m_original_file_name << " doesn't fit in the free space of the atlas. Doing a full build." << std::endl;
+				incremental = false;
+				break;
+			}
+			dirty_atlas_rectangles.push_back(texture.atlas_footprint());
+			packing_timer->items++;
+			std::cout << " - Fitted subtexture " << lead_blanks(texture.m_original_file_name, length_longest_filename) << " into free space." << std::endl;
+		}
+	}
+	if (incremental && atlas_rectangle_bin_pack.Fragmentation() > vt_repack_threshold)
+	{
+		std::cout << "Atlas free space fragmentation " << atlas_rectangle_bin_pack.Fragmentation() << " exceeds repack threshold " << vt_repack_threshold << ". Doing a full build." << std::endl;
+		incremental = false;
+	}
+	packing_timer.reset();
+
+	// Falling back to a full build after all means decoding whatever was skipped.
+	const bool resume_atlas = resuming_atlas && std::all_of(subtextures.begin(), subtextures.end(), [](const subtexture &texture) { return !texture.m_loaded; });
+	if (!incremental && !resume_atlas)
+	{
+		for (subtexture &texture : subtextures)
+		{
+			if (!texture.m_loaded)
+			{
+				texture = load_subtexture(texture.m_index, texture.m_source_path, texture.m_content_hash);
+				std::cout << (texture.m_bordered ? " - Cached subtexture " : " - Loaded subtexture ") << lead_blanks(texture.m_original_file_name, length_longest_filename) << ", " << lead_blanks(texture.m_texels_wide, 4) << " * " << lead_blanks(texture.m_texels_high, 4) << " texels." << std::endl;
+			}
+			texture.m_atlas_node.reset();
+		}
+		dirty_atlas_rectangles.clear();
 	}
 	std::cout << std::endl;
 
+	if (incremental && dirty_atlas_rectangles.empty() && vt_serve.empty())
+	{
+		save_build_stats();
+		std::cout << "Nothing changed since the previous build.\nBye bye." << std::endl;
+		return 0;
+	}
+
+	// Reruns into an existing output path refresh what's there.
+	ilState::Enable(IL_FILE_OVERWRITE);
+
 	// Prepare root directory.
 	boost::filesystem::path output_dir(output_path);
 	if (!boost::filesystem::exists(output_dir))
@@ -332,6 +1064,10 @@ int main(int argc, char *argv[])
 	{
 		std::cout << "Output directory " << output_dir << " exists." << std::endl;
 	}
+	if (vt_serve.empty() && !journal.open(build_journal_file_path, current_build_key, resuming))
+	{
+		std::cout << "Couldn't write build journal " << build_journal_file_path << ". This build can't be resumed." << std::endl;
+	}
 	std::cout << std::endl;
 
 
@@ -339,16 +1075,51 @@ int main(int argc, char *argv[])
 	// Step 1a: Add an inset wrapping borders to all subtextures.
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	boost::filesystem::path wrapping_border_folder_path( output_dir.string() + "\\1a_wrappingborders");
-	boost::filesystem::create_directory(wrapping_border_folder_path);
-	std::cout << "Creating subtextures with wrapping borders in " << wrapping_border_folder_path.string() << "..." << std::endl;
+	boost::filesystem::path wrapping_border_folder_path( output_dir / "1a_wrappingborders");
+	if (emit_borders)
+	{
+		boost::filesystem::create_directory(wrapping_border_folder_path);
+		std::cout << "Creating subtextures with wrapping borders in " << wrapping_border_folder_path.string() << "..." << std::endl;
+	}
+	else
+	{
+		std::cout << "Creating subtextures with wrapping borders..." << std::endl;
+	}
 
 	for (subtexture &subtexture : subtextures)
 	{
-		subtexture.add_inset_border(vt_subtexture_border_texels_wide);
-		std::string file_path = wrapping_border_folder_path.string() + "\\" + subtexture.m_original_file_name;
+		if (!subtexture.m_loaded)
+		{
+			continue; // Bordered by a previous build already.
+		}
+		if (!subtexture.m_bordered)
+		{
+			stage_timer timer(pipeline_stats, "border");
+			timer.detail = subtexture.m_original_file_name;
+			timer.bytes_in = subtexture.texel_bytes();
+			subtexture.add_inset_border(vt_subtexture_border_texels_wide);
+			bordered_subtexture_cache.store(cache_key(subtexture.m_content_hash), subtexture.to_cache());
+			timer.bytes_out = subtexture.texel_bytes();
+		}
+		if (!emit_borders)
+		{
+			continue;
+		}
+		std::string file_path = (wrapping_border_folder_path / subtexture.m_original_file_name).string();
 		std::cout << " - Saving subtexture " << subtexture.m_original_file_name << "." << std::endl;
+		stage_timer timer(pipeline_stats, "emit");
+		timer.detail = subtexture.m_original_file_name;
+		timer.bytes_in = subtexture.texel_bytes();
 		subtexture.m_image.Save(file_path.c_str());
+		for (size_t l = 1; l < layer_count; l++)
+		{
+			subtexture.layer(l).Save((wrapping_border_folder_path / boost::filesystem::path(subtexture.m_extra_layer_paths[l - 1]).filename()).string().c_str());
+		}
+	}
+	if (bordered_subtexture_cache.enabled())
+	{
+		std::cout << "Subtexture cache hits: " << bordered_subtexture_cache.hits() << ", misses: " << bordered_subtexture_cache.misses() << "." << std::endl;
+		bordered_subtexture_cache.evict();
 	}
 	std::cout << std::endl;
 
@@ -357,35 +1128,182 @@ int main(int argc, char *argv[])
 	// Step 1b: Add all subtextures to a texture atlas.
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	boost::filesystem::path atlas_folder_path(output_dir.string() + "\\1b_atlas");
-	boost::filesystem::create_directory(atlas_folder_path);
-	std::cout << "Creating atlas in " << atlas_folder_path.string() << "..." << std::endl;
+	boost::filesystem::path atlas_folder_path(output_dir / "1b_atlas");
+	if (emit_atlas)
+	{
+		boost::filesystem::create_directory(atlas_folder_path);
+		std::cout << "Creating atlas in " << atlas_folder_path.string() << "..." << std::endl;
+	}
+	else
+	{
+		std::cout << "Creating atlas..." << std::endl;
+	}
 
-	// Prepare atlas bin and image.
-	RectangleBinPack atlas_rectangle_bin_pack;
-	atlas_rectangle_bin_pack.Init((int)vt_atlas_texels_wide, (int)vt_atlas_texels_wide);
+	// Prepare atlas image. (The atlas bin was prepared while loading subtextures.)
 	ilState::Enable(IL_ORIGIN_SET);
 	ilState::Origin(IL_ORIGIN_UPPER_LEFT); // Just to be sure. Just how we like it by convention.
-	ilImage atlas_image;
-	atlas_image.TexImage(vt_atlas_texels_wide, vt_atlas_texels_wide, 1, vt_atlas_bpp, vt_atlas_format, vt_atlas_type, NULL);
-	atlas_image.Bind();
-	ilClearImage(); // Just to get rid off garbage values. Nice for debugging.
-
-	// Add each subtexture to atlas bin and image.
+	std::vector<ilImage> atlas_images(layer_count); // One per layer, all with the same placements.
+	ilImage &atlas_image = atlas_images.front();
 	const unsigned int nr_characters_texel_coordinates = (unsigned int)std::to_string(vt_atlas_texels_wide).size();
-	for (subtexture &subtexture : subtextures)
+	if (incremental || resume_atlas)
+	{
+		// Start from the previous atlas and only overwrite what changed. (Nothing did, if resuming.)
+		std::cout << "Loading atlas of previous build " << atlas_file_path << "." << std::endl;
+		{
+			stage_timer timer(pipeline_stats, "load");
+			timer.detail = "atlas";
+			boost::system::error_code ignored;
+			timer.bytes_in = boost::filesystem::file_size(atlas_file_path, ignored);
+			if (!atlas_image.Load(atlas_file_path.c_str()) || atlas_image.Width() != vt_atlas_texels_wide || atlas_image.Height() != vt_atlas_texels_wide)
+			{
+				std::cout << "Couldn't load atlas of previous build. Exiting..." << std::endl;
+				return 1;
+			}
+			convert_to_layout(atlas_image, vt_atlas_layout);
+			timer.bytes_out = (uint64_t)vt_atlas_texels_wide * vt_atlas_texels_wide * vt_atlas_bpp;
+		}
+		packing_timer.reset(new stage_timer(pipeline_stats, "pack", 0));
+
+		// Clear where removed subtextures used to be.
+		for (const atlas_rectangle &removed : removed_atlas_rectangles)
+		{
+			std::vector<ILubyte> blank(removed.width * removed.height * vt_atlas_bpp, 0);
+			atlas_image.Bind();
+			ilSetPixels(removed.x, removed.y, 0, removed.width, removed.height, 1, vt_atlas_format, vt_atlas_type, blank.data());
+		}
+
+		// Overwrite changed subtextures in place and add new ones where they were fitted.
+		for (subtexture &subtexture : subtextures)
+		{
+			if (!subtexture.m_loaded)
+			{
+				continue;
+			}
+			{
+				trace_scope span("place", subtexture.m_original_file_name);
+				subtexture.overlay_onto_atlas(atlas_images);
+			}
+			packing_timer->items++;
+			packing_timer->bytes_in += subtexture.texel_bytes();
+			std::cout
+				<< " - Updated subtexture " << lead_blanks(subtexture.m_original_file_name, length_longest_filename)
+				<< " at coordinates " << lead_blanks(subtexture.top_left_texel_within_atlas_x(), nr_characters_texel_coordinates)
+				<< ", " << lead_blanks(subtexture.top_left_texel_within_atlas_y(), nr_characters_texel_coordinates) << "." << std::endl;
+		}
+	}
+	else
+	{
+		packing_timer.reset(new stage_timer(pipeline_stats, "pack", 0));
+		atlas_rectangle_bin_pack.Init((int)vt_atlas_texels_wide, (int)vt_atlas_texels_wide);
+		for (ilImage &layer_atlas_image : atlas_images)
+		{
+			layer_atlas_image.TexImage(vt_atlas_texels_wide, vt_atlas_texels_wide, 1, vt_atlas_bpp, vt_atlas_format, vt_atlas_type, NULL);
+			layer_atlas_image.Bind();
+			ilClearImage(); // Just to get rid off garbage values. Nice for debugging.
+		}
+
+		// Add each subtexture to atlas bin and image.
+		for (subtexture &subtexture : subtextures)
+		{
+			{
+				trace_scope span("place", subtexture.m_original_file_name);
+				subtexture.add_to_atlas(atlas_rectangle_bin_pack, atlas_images);
+			}
+			packing_timer->items++;
+			packing_timer->bytes_in += subtexture.texel_bytes();
+			std::cout
+				<< " - Assigned subtexture " << lead_blanks(subtexture.m_original_file_name, length_longest_filename)
+				<< " to coordinates " << lead_blanks(subtexture.top_left_texel_within_atlas_x(), nr_characters_texel_coordinates)
+				<< ", " << lead_blanks(subtexture.top_left_texel_within_atlas_y(), nr_characters_texel_coordinates) << "." << std::endl;
+		}
+	}
+
+	packing_timer->bytes_out = (uint64_t)vt_atlas_texels_wide * vt_atlas_texels_wide * vt_atlas_bpp * layer_count;
+	packing_timer.reset();
+
+	// A resumed build never refilled the atlas bin, so count the texels of the placements instead.
+	float atlas_occupancy = atlas_rectangle_bin_pack.Occupancy();
+	if (resume_atlas && !incremental)
+	{
+		uint64_t used_texels = 0;
+		for (subtexture &subtexture : subtextures)
+		{
+			used_texels += (uint64_t)subtexture.m_texels_wide * subtexture.m_texels_high;
+		}
+		atlas_occupancy = (float)((double)used_texels / ((double)vt_atlas_texels_wide * vt_atlas_texels_wide));
+	}
+	if (vt_report_path.empty())
 	{
-		subtexture.add_to_atlas(atlas_rectangle_bin_pack, atlas_image);
-		std::cout
-			<< " - Assigned subtexture " << lead_blanks(subtexture.m_original_file_name, length_longest_filename)
-			<< " to coordinates " << lead_blanks(subtexture.top_left_texel_within_atlas_x(), nr_characters_texel_coordinates)
-			<< ", " << lead_blanks(subtexture.top_left_texel_within_atlas_y(), nr_characters_texel_coordinates) << "." << std::endl;
+		std::cout << "Atlas occupancy: " << atlas_occupancy * 100.0f << "%." << std::endl;
 	}
 
-	// Save atlas image.
-	const std::string file_path = atlas_folder_path.string() + "\\atlas" + vt_atlas_file_format;
-	std::cout << "Saving atlas " << file_path << "." << std::endl;
-	atlas_image.Save(file_path.c_str());
+	// Work out what the tiles will cost before making any of them. The tile formats are sampled on a few
+	// tiles of the finest level, cut straight from the atlas, plus one empty tile.
+	if (!vt_report_path.empty())
+	{
+		atlas_report report(vt_atlas_texels_wide, vt_tile_texels_wide, vt_tile_border_texels_wide, vt_atlas_bpp);
+		report.set_occupancy(atlas_occupancy);
+		for (subtexture &subtexture : subtextures)
+		{
+			report.add_subtexture(subtexture.m_original_file_name, subtexture.atlas_footprint());
+		}
+		report.finish();
+
+		const texel_layout layout = { vt_atlas_bpp, vt_atlas_format, vt_atlas_type };
+		const std::vector<tile_coordinate> samples = report.content_tiles(mipIDForDimensions(vt_atlas_texels_wide / vt_tile_texels_wide), 16);
+		ilImage empty_tile;
+		empty_tile.TexImage(vt_tile_texels_wide, vt_tile_texels_wide, 1, vt_atlas_bpp, vt_atlas_format, vt_atlas_type, NULL);
+		empty_tile.Bind();
+		ilClearImage();
+
+		std::vector<std::string> formats = { vt_tile_file_format, ".png", ".jpg", ".tga", ".bmp" };
+		std::transform(formats.begin(), formats.end(), formats.begin(), [](std::string format) { boost::algorithm::to_lower(format); return format; });
+		formats.erase(std::remove_if(formats.begin() + 1, formats.end(), [&formats](const std::string &format) { return format == formats.front(); }), formats.end());
+		for (const std::string &format : formats)
+		{
+			std::vector<uint8_t> encoded;
+			if (!encode_image(empty_tile, format, encoded))
+			{
+				continue; // No encoder for this one.
+			}
+			const double empty_tile_bytes = (double)encoded.size();
+			double content_tile_bytes = 0.0;
+			for (const tile_coordinate &sample : samples)
+			{
+				ilImage tile_image;
+				cut_tile(atlas_image, sample.x, sample.y, vt_tile_texels_wide, 0, layout, tile_image);
+				encode_image(tile_image, format, encoded);
+				content_tile_bytes += (double)encoded.size();
+			}
+			report.add_format_sample(format, samples.empty() ? empty_tile_bytes : content_tile_bytes / samples.size(), empty_tile_bytes, samples.size());
+		}
+
+		report.print(std::cout);
+		const bool saved = report.save_json(vt_report_path);
+		std::cout << (saved ? "Saved atlas report " : "Couldn't save atlas report ") << vt_report_path << "." << std::endl;
+	}
+
+	// Save atlas image. Only a saved atlas can be picked up by a resumed build.
+	if (emit_atlas && !resume_atlas)
+	{
+		for (size_t l = 0; l < layer_count; l++)
+		{
+			const std::string layer_atlas_file_path = (atlas_folder_path / layer_file_name("atlas", vt_atlas_file_format, l)).string();
+			std::cout << "Saving atlas " << layer_atlas_file_path << "." << std::endl;
+			stage_timer timer(pipeline_stats, "emit");
+			timer.detail = layer_file_name("atlas", "", l);
+			timer.bytes_in = (uint64_t)vt_atlas_texels_wide * vt_atlas_texels_wide * vt_atlas_bpp;
+			atlas_images[l].Save(layer_atlas_file_path.c_str());
+		}
+
+		std::vector<manifest_subtexture> placements;
+		for (subtexture &subtexture : subtextures)
+		{
+			placements.push_back(subtexture.to_manifest());
+		}
+		journal.record_placements(placements);
+		journal.complete_stage("atlas");
+	}
 	std::cout << std::endl;
 
 
@@ -393,7 +1311,8 @@ int main(int argc, char *argv[])
 	// Step 1c: Generate XML output about subtexture positions in atlas
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	boost::filesystem::path atlas_xml_folder_path(output_dir.string() + "\\1c_atlas_xml");
+	std::unique_ptr<stage_timer> xml_timer(new stage_timer(pipeline_stats, "xml"));
+	boost::filesystem::path atlas_xml_folder_path(output_dir / "1c_atlas_xml");
 	boost::filesystem::create_directory(atlas_xml_folder_path);
 	std::cout << "Creating atlas subtexture info xml in " << atlas_xml_folder_path.string() << "..." << std::endl;
 
@@ -411,10 +1330,18 @@ int main(int argc, char *argv[])
 	xml_atlas.append_attribute("imagePath");
 	xml_atlas.append_attribute("width");
 	xml_atlas.append_attribute("height");
-	xml_atlas.attribute("imagePath").set_value(("atlas" + vt_atlas_file_format).c_str());
+	xml_atlas.attribute("imagePath").set_value(layer_file_name("atlas", vt_atlas_file_format, 0).c_str());
 	xml_atlas.attribute("width").set_value(vt_atlas_texels_wide);
 	xml_atlas.attribute("height").set_value(vt_atlas_texels_wide);
 
+	// Every layer has its own atlas image, sprites are the same for all. (Not part of the TexturePacker format.)
+	for (size_t l = 0; l < layer_count && layered; l++)
+	{
+		pugi::xml_node xml_layer = xml_atlas.append_child("layer");
+		xml_layer.append_attribute("n").set_value(layer_names[l].c_str());
+		xml_layer.append_attribute("imagePath").set_value(layer_file_name("atlas", vt_atlas_file_format, l).c_str());
+	}
+
 	// Add each subtexture's details to xml document.
 	for (subtexture &subtexture : subtextures)
 	{
@@ -437,9 +1364,10 @@ int main(int argc, char *argv[])
 	}
 
 	// Save file.
-	const std::string atlas_xml_file_path = atlas_xml_folder_path.string() + "\\atlas.xml";
+	const std::string atlas_xml_file_path = (atlas_xml_folder_path / "atlas.xml").string();
 	std::cout << "Saving xml document " << atlas_xml_file_path << "." << std::endl;
 	atlas_xml_document.save_file(atlas_xml_file_path.c_str(), PUGIXML_TEXT("    "), pugi::format_default, pugi::encoding_utf8);
+	xml_timer.reset();
 	std::cout << std::endl;
 
 
@@ -447,9 +1375,16 @@ int main(int argc, char *argv[])
 	// Step 2: Create mipmaps of the texture atlas.
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	boost::filesystem::path mipmapped_atlas_folder_path(output_dir.string() + "\\2_mipmapped_atlas");
-	boost::filesystem::create_directory(mipmapped_atlas_folder_path);
-	std::cout << "Creating atlas mipmaps in " << mipmapped_atlas_folder_path.string();
+	boost::filesystem::path mipmapped_atlas_folder_path(output_dir / "2_mipmapped_atlas");
+	if (emit_mipmaps)
+	{
+		boost::filesystem::create_directory(mipmapped_atlas_folder_path);
+		std::cout << "Creating atlas mipmaps in " << mipmapped_atlas_folder_path.string();
+	}
+	else
+	{
+		std::cout << "Creating atlas mipmaps";
+	}
 
 	// At this point I really wanna make sure that we've got power-of-two stuff going on here.
 	assert(is_power_of_two(vt_atlas_texels_wide));
@@ -471,122 +1406,416 @@ int main(int argc, char *argv[])
 	// Note that the tile (pool) mip level of 1x1 tile has a tile mipID 0 and that every next power of two has a 1 higher mipID.
 	// Ready?
 
-	// Prepare image vector for mipmap levels.
-	std::vector<ilImage*> atlas_mipmaps;
-    ILuint current_mipmap_texels_wide = atlas_image.Width();
-    iluImageParameter(ILU_FILTER, ILU_BILINEAR);
-
-	// Generate mipmap levels down to tile size and add to vector.
-    while (current_mipmap_texels_wide >= vt_tile_texels_wide)
+	// Prepare image vector for mipmap levels. Index corresponds to tile mipID.
+	// Each level is box filtered from the next finer one, the finest from the atlas, so no level reads more than about
+	// four times its own size. A changed part of the atlas can be followed down the levels and redone on its own.
+	const unsigned int max_atlas_tile_mipID = mipIDForDimensions(vt_atlas_texels_wide / vt_tile_texels_wide);
+	std::vector<std::vector<ilImage*>> layer_mipmaps(layer_count, std::vector<ilImage*>(max_atlas_tile_mipID + 1, nullptr));
+	std::vector<ilImage*> &atlas_mipmaps = layer_mipmaps.front();
+	std::vector<std::set<tile_coordinate>> dirty_tiles_per_mipID(max_atlas_tile_mipID + 1);
+	const bool resume_mipmaps = resume_atlas && journal.stage_completed("mipmaps");
+	const std::vector<atlas_rectangle> no_rectangles;
+
+	// What changed in the atlas, in texels of the level last resampled.
+	std::vector<atlas_rectangle> dirty_source_rectangles = dirty_atlas_rectangles;
+	unsigned int source_texels_wide = vt_atlas_texels_wide;
+
+	// Generate mipmap levels down to tile size, finest first.
+	for (int atlas_tile_mipID = (int)max_atlas_tile_mipID; atlas_tile_mipID >= 0; atlas_tile_mipID--)
 	{
 		// Give some output.
 		std::cout << ".";
+		stage_timer timer(pipeline_stats, "mip");
+		timer.detail = "mipID " + std::to_string(atlas_tile_mipID);
+
+		// Downscale mipmap slightly more to accomodate for tile borders while retaining power-of-two page table.
+		const unsigned int current_mipmap_texels_wide_scaled = mipmap_texels_wide_scaled(atlas_tile_mipID, vt_tile_texels_wide, vt_tile_border_texels_wide);
+		std::vector<atlas_rectangle> dirty_mipmap_rectangles;
+		for (const atlas_rectangle &changed : dirty_source_rectangles)
+		{
+			dirty_mipmap_rectangles.push_back(mipmap_region_for(changed, source_texels_wide, current_mipmap_texels_wide_scaled));
+		}
+		std::vector<atlas_rectangle> full_mipmap_rectangle(1);
+		full_mipmap_rectangle[0].width  = current_mipmap_texels_wide_scaled;
+		full_mipmap_rectangle[0].height = current_mipmap_texels_wide_scaled;
+
+		for (size_t l = 0; l < layer_count; l++)
+		{
+			const std::string mipmap_level_file_path = (mipmapped_atlas_folder_path / layer_file_name("atlas_" + std::to_string(atlas_tile_mipID), vt_atlas_file_format, l)).string();
 
-        // Downscale mipmap slightly more to accomodate for tile borders while retaining power-of-two page table.
-        const unsigned int current_mipmap_tiles_wide = current_mipmap_texels_wide / vt_tile_texels_wide;
-        const unsigned int current_mipmap_texels_wide_scaled = current_mipmap_texels_wide - current_mipmap_tiles_wide * 2 * vt_tile_border_texels_wide;
+			// When building upon a previous build, start from the level saved back then and only redo what changed.
+			// A resumed build that got this far before has nothing left to redo.
+			ilImage* current_mipmap_level = new ilImage();
+			const std::vector<atlas_rectangle>* changed_mipmap_rectangles = &full_mipmap_rectangle;
+			if ((incremental || resume_mipmaps) && current_mipmap_level->Load(mipmap_level_file_path.c_str()) && current_mipmap_level->Width() == current_mipmap_texels_wide_scaled && current_mipmap_level->Height() == current_mipmap_texels_wide_scaled)
+			{
+				convert_to_layout(*current_mipmap_level, vt_atlas_layout);
+				changed_mipmap_rectangles = resume_mipmaps ? &no_rectangles : &dirty_mipmap_rectangles;
+			}
+			else
+			{
+				current_mipmap_level->TexImage(current_mipmap_texels_wide_scaled, current_mipmap_texels_wide_scaled, 1, vt_atlas_bpp, vt_atlas_format, vt_atlas_type, NULL);
+			}
 
-        // Create new mipmap
-        ilImage* current_mipmap_level = new ilImage();
-        current_mipmap_level->Copy(atlas_image.GetId());
-        current_mipmap_level->Resize(current_mipmap_texels_wide_scaled, current_mipmap_texels_wide_scaled, 1);
+			// Resample whatever changed and remember which tiles that touches. All layers touch the same ones.
+			ilImage &source_image = atlas_tile_mipID == (int)max_atlas_tile_mipID ? atlas_images[l] : *layer_mipmaps[l][atlas_tile_mipID + 1];
+			for (const atlas_rectangle &mipmap_region : *changed_mipmap_rectangles)
+			{
+				timer.bytes_in  += (uint64_t)mipmap_region.width * mipmap_region.height * vt_atlas_bpp * source_texels_wide / current_mipmap_texels_wide_scaled * source_texels_wide / current_mipmap_texels_wide_scaled;
+				timer.bytes_out += (uint64_t)mipmap_region.width * mipmap_region.height * vt_atlas_bpp;
+				resample_region(source_image.GetData(), source_texels_wide, source_texels_wide,
+					current_mipmap_level->GetData(), current_mipmap_texels_wide_scaled, current_mipmap_texels_wide_scaled,
+					vt_atlas_bpp, mipmap_region);
+				if (l == 0)
+				{
+					const std::set<tile_coordinate> overlapping = tiles_overlapping(mipmap_region, atlas_tile_mipID, vt_tile_texels_wide, vt_tile_border_texels_wide);
+					dirty_tiles_per_mipID[atlas_tile_mipID].insert(overlapping.begin(), overlapping.end());
+				}
+			}
 
-        // Add to vector.
-        atlas_mipmaps.push_back(current_mipmap_level);
+			// Add to vector.
+			layer_mipmaps[l][atlas_tile_mipID] = current_mipmap_level;
+		}
 
-        // Calculate what would be the size of next (smaller) mipmap level.
-        current_mipmap_texels_wide /= 2;
+		dirty_source_rectangles = dirty_mipmap_rectangles;
+		source_texels_wide      = current_mipmap_texels_wide_scaled;
 	}
-    std::cout << std::endl;
-	
-	// Reverse mipmap levels so that index corresponds to tile mipID.
-	std::reverse(atlas_mipmaps.begin(), atlas_mipmaps.end());
+	std::cout << std::endl;
 
 	// Save all mipmap levels to file.
-	for (size_t atlas_tile_mipID = 0; atlas_tile_mipID < atlas_mipmaps.size(); atlas_tile_mipID++)
+	for (size_t atlas_tile_mipID = 0; atlas_tile_mipID < atlas_mipmaps.size() && emit_mipmaps; atlas_tile_mipID++)
+	{
+		if ((incremental || resume_mipmaps) && dirty_tiles_per_mipID[atlas_tile_mipID].empty())
+		{
+			continue;
+		}
+		for (size_t l = 0; l < layer_count; l++)
+		{
+			const std::string mipmap_level_file_name = layer_file_name("atlas_" + std::to_string(atlas_tile_mipID), vt_atlas_file_format, l);
+			std::cout << " - Saving atlas tile mipID " << atlas_tile_mipID << " to " << mipmap_level_file_name << "." << std::endl;
+			stage_timer timer(pipeline_stats, "emit");
+			timer.detail = "mipID " + std::to_string(atlas_tile_mipID);
+			timer.bytes_in = (uint64_t)layer_mipmaps[l][atlas_tile_mipID]->Width() * layer_mipmaps[l][atlas_tile_mipID]->Height() * vt_atlas_bpp;
+			layer_mipmaps[l][atlas_tile_mipID]->Save((mipmapped_atlas_folder_path / mipmap_level_file_name).string().c_str());
+		}
+	}
+	if (incremental)
+	{
+		size_t invalidated_tiles = 0;
+		size_t total_tiles       = 0;
+		for (size_t atlas_tile_mipID = 0; atlas_tile_mipID < atlas_mipmaps.size(); atlas_tile_mipID++)
+		{
+			invalidated_tiles += dirty_tiles_per_mipID[atlas_tile_mipID].size();
+			total_tiles       += (size_t)1 << (2 * atlas_tile_mipID);
+		}
+		std::cout << "Changes since previous build invalidate " << invalidated_tiles << " of " << total_tiles << " tiles." << std::endl;
+	}
+	if (emit_mipmaps && !resume_mipmaps)
 	{
-		const std::string mipmap_level_file_path = mipmapped_atlas_folder_path.string() + "\\atlas_" + std::to_string(atlas_tile_mipID) + vt_atlas_file_format;
-		std::cout << " - Saving atlas tile mipID " << atlas_tile_mipID << " to atlas_" + std::to_string(atlas_tile_mipID) + vt_atlas_file_format + "." << std::endl;
-		atlas_mipmaps[atlas_tile_mipID]->Save(mipmap_level_file_path.c_str());
+		journal.complete_stage("mipmaps");
 	}
 	std::cout << std::endl;
 
 
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Serving: Rather than cutting all tiles now, cut each one when it's first asked for.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	if (!vt_serve.empty())
+	{
+		tile_server server(
+			[&atlas_mipmaps](const unsigned int &mipID, const unsigned int &x, const unsigned int &y, std::vector<uint8_t> &encoded) {
+				if (mipID >= atlas_mipmaps.size() || x >= (1u << mipID) || y >= (1u << mipID))
+				{
+					return false;
+				}
+				ilImage tile_image;
+				cut_tile(*atlas_mipmaps[mipID], x, y, vt_tile_texels_wide, vt_tile_border_texels_wide, { vt_atlas_bpp, vt_atlas_format, vt_atlas_type }, tile_image);
+				return encode_image(tile_image, vt_tile_file_format, encoded);
+			},
+			(unsigned int)atlas_mipmaps.size(), content_type_for_extension(vt_tile_file_format), (size_t)vt_serve_cache_mib << 20, vt_serve_threads);
+		if (!server.listen(vt_serve))
+		{
+			std::cout << "Couldn't serve tiles on " << vt_serve << ": " << server.error() << ". Exiting..." << std::endl;
+			return 1;
+		}
+		std::cout << "Serving tiles as /tiles/<mipID>/<x>/<y> on " << vt_serve << ". Stop with Ctrl+C." << std::endl;
+		server.run();
+
+		const tile_server_stats stats = server.stats();
+		std::cout << "Answered " << stats.requests << " requests, generated " << stats.tiles_generated << " tiles, "
+			<< stats.cache_hits << " cache hits, " << stats.cache_misses << " cache misses." << std::endl;
+		save_build_stats();
+		for (std::vector<ilImage*> &mipmaps : layer_mipmaps)
+		{
+			for (ilImage* mipmap_level : mipmaps)
+			{
+				delete mipmap_level;
+			}
+		}
+		std::cout << "Bye bye." << std::endl;
+		return 0;
+	}
+
+
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// Step 3a: Cut all atlas mipmaps into bordered tiles
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	boost::filesystem::path tiles_folder_path(output_dir.string() + "\\3a_tiles");
+	boost::filesystem::path tiles_folder_path(output_dir / "3a_tiles");
 	boost::filesystem::create_directory(tiles_folder_path);
 	std::cout << "Creating tiles in " << tiles_folder_path.string() << "." << std::endl;
 
-	// Values used down the line.
-	const unsigned int payload_texels_wide = vt_tile_texels_wide - 2 * vt_tile_border_texels_wide;
-
 	// Values used down the line for saving tiles to file.
 	const unsigned int atlas_tiles_wide        = vt_atlas_texels_wide / vt_tile_texels_wide;
 	const unsigned int nr_characters_for_coord = (unsigned int)std::to_string(atlas_tiles_wide - 1).size();
 	const unsigned int nr_characters_for_mipID = (unsigned int)std::to_string(atlas_mipmaps.size() - 1).size();
 
-	// Downscale all mipmap levels to make room for tile borders and cut up in bordered tiles.
+	// Either save each tile as an image file or add its raw texels to a tile pack. Each layer gets its own pack or folder,
+	// unless all layers are interleaved in one pack.
+	const size_t tile_bytes = vt_tile_texels_wide * vt_tile_texels_wide * vt_atlas_bpp;
+	std::vector<std::unique_ptr<tile_pack_writer>> tile_packs(vt_tile_container == "pack" ? (vt_interleave_layers ? 1 : layer_count) : 0);
+	for (size_t l = 0; l < tile_packs.size(); l++)
+	{
+		const std::string tile_pack_file_path = (tiles_folder_path / (vt_interleave_layers ? "tiles.vtpack" : layer_file_name("tiles", ".vtpack", l))).string();
+		tile_packs[l].reset(new tile_pack_writer(tile_pack_file_path, vt_tile_codec, vt_tile_codec_level, vt_tile_texels_wide, vt_tile_border_texels_wide, vt_atlas_bpp, vt_tile_dictionary_bytes, vt_tile_dictionary_sample_tiles,
+			vt_interleave_layers ? (unsigned int)layer_count : 1));
+		if (!tile_packs[l]->is_open())
+		{
+			std::cout << "Couldn't create tile pack " << tile_pack_file_path << ". Exiting..." << std::endl;
+			return 1;
+		}
+	}
+	// Tile files are encoded here and written in the background, so cutting doesn't wait on the filesystem.
+	std::unique_ptr<tile_writer> tile_file_writer;
+	std::vector<tile_path_builder> layer_tile_paths;
+	if (tile_packs.empty())
+	{
+		layer_tile_paths.reserve(layer_count);
+		for (size_t l = 0; l < layer_count; l++)
+		{
+			const boost::filesystem::path layer_tiles_folder_path = layered ? tiles_folder_path / layer_names[l] : tiles_folder_path;
+			boost::filesystem::create_directory(layer_tiles_folder_path);
+			layer_tile_paths.emplace_back(layer_tiles_folder_path.string(), vt_tile_layout, vt_tile_shard_fan_out, vt_tile_file_format);
+			if (!layer_tile_paths.back().create_directories((unsigned int)atlas_mipmaps.size() - 1))
+			{
+				std::cout << "Couldn't create tile directories in " << layer_tiles_folder_path.string() << ". Exiting..." << std::endl;
+				return 1;
+			}
+		}
+		tile_file_writer.reset(new tile_writer(vt_tile_writer_backend, vt_tile_writer_threads, (size_t)vt_tile_writer_in_flight_mib << 20, vt_tile_writer_batch_size));
+		std::cout << "Writing tile files using the " << tile_writer_backend_to_string(tile_file_writer->backend()) << " tile writer." << std::endl;
+	}
+
+	// A row of tile files goes into the journal once every one of its files made it to disk, so a resumed build can skip it.
+	// (A tile pack is only complete once closed, so that is redone as a whole.)
+	struct tile_row_progress
+	{
+		unsigned int planned = 0;
+		unsigned int written = 0;
+		bool         failed  = false;
+	};
+	typedef std::pair<unsigned int, unsigned int> tile_row; // Tile mipID, tile y.
+	std::mutex                          tile_rows_mutex;
+	std::map<tile_row, tile_row_progress> tile_rows_in_flight;
+	std::map<std::string, tile_row>     tile_rows_by_path;
+	auto journal_tile_row_if_written = [&](const tile_row &row) {
+		const tile_row_progress &progress = tile_rows_in_flight[row];
+		if (!progress.failed && progress.written == progress.planned)
+		{
+			journal.complete_tile_row(row.first, row.second);
+			tile_rows_in_flight.erase(row);
+		}
+	};
+	if (tile_file_writer)
+	{
+		tile_file_writer->set_completion_callback([&](const std::string &file_path, const size_t &, const bool &success) {
+			std::lock_guard<std::mutex> lock(tile_rows_mutex);
+			const auto written_path = tile_rows_by_path.find(file_path);
+			if (written_path == tile_rows_by_path.end())
+			{
+				return;
+			}
+			const tile_row row = written_path->second;
+			tile_rows_by_path.erase(written_path);
+			tile_row_progress &progress = tile_rows_in_flight[row];
+			progress.written += success ? 1 : 0;
+			progress.failed  |= !success;
+			journal_tile_row_if_written(row);
+		});
+	}
+
+	// Plan which tiles to generate: coarsest mipID first, then row by row.
+	std::vector<planned_tile> planned_tiles;
 	for (size_t atlas_tile_mipID = 0; atlas_tile_mipID < atlas_mipmaps.size(); atlas_tile_mipID++)
 	{
 		// Give some output.
-		std::cout << " - Processing mipmap level with tile mipID " << atlas_tile_mipID;
+		std::cout << " - Planning mipmap level with tile mipID " << atlas_tile_mipID;
 
         // Calculate mipmap dimension in tiles.
         const unsigned int mipmap_level_tiles_wide = 1 << atlas_tile_mipID;
 
-		// Loop over all tiles in mipmap level and create and save.
+		// When building upon a previous build, only tiles that sample from changed parts of the atlas are redone.
+		const std::set<tile_coordinate> &dirty_tiles = dirty_tiles_per_mipID[atlas_tile_mipID];
+		if (incremental)
+		{
+			std::cout << ", " << dirty_tiles.size() << " of " << mipmap_level_tiles_wide * mipmap_level_tiles_wide << " tiles changed";
+		}
+
+		// Loop over all tiles in mipmap level.
+		const size_t planned_before = planned_tiles.size();
 		for (unsigned int tile_y = 0; tile_y < mipmap_level_tiles_wide; ++tile_y)
 		{
+			if (resuming && journal.tile_row_completed((unsigned int)atlas_tile_mipID, tile_y))
+			{
+				continue; // Written by the interrupted build.
+			}
+
 			for (unsigned int tile_x = 0; tile_x < mipmap_level_tiles_wide; ++tile_x)
 			{
-				// Give some output.
-				std::cout << ".";
-
-				// Coordinates in atlas mipmap. (Minus border width is to give tiles a border with data from neighbouring tiles.)
-				const int tile_top_left_atlas_texel_x = tile_x                                 * payload_texels_wide - vt_tile_border_texels_wide;
-				const int tile_top_left_atlas_texel_y = (mipmap_level_tiles_wide - 1 - tile_y) * payload_texels_wide - vt_tile_border_texels_wide;
-				// Note: Tile-coordinates, like UV-coordinates, use a lower left origin (in my implementation at least).
-				//       At texel level this program uses an upper left origin for image manipulation. Unlike the x-axis, the tile-y-axis is therefore flipped above.
-
-				// Used for check whether sampling inside atlas mipmap. (See below.)
-				const int tile_lower_right_atlas_texel_x = tile_top_left_atlas_texel_x + vt_tile_texels_wide;
-				const int tile_lower_right_atlas_texel_y = tile_top_left_atlas_texel_y + vt_tile_texels_wide;
-				
-				// We need to take care of some "edge" conditions, specifically for borders sampling outside of the texture atlas.
-				const unsigned int texels_past_left_border  = tile_top_left_atlas_texel_x     <  0                                             ? (unsigned int)( -tile_top_left_atlas_texel_x                                               ) : 0;
-				const unsigned int texels_past_upper_border = tile_top_left_atlas_texel_y     <  0                                             ? (unsigned int)( -tile_top_left_atlas_texel_y                                               ) : 0;
-				const unsigned int texels_past_right_border = tile_lower_right_atlas_texel_x >= (int)atlas_mipmaps[atlas_tile_mipID]->Width()  ? (unsigned int)( tile_lower_right_atlas_texel_x - atlas_mipmaps[atlas_tile_mipID]->Width()  ) : 0;
-				const unsigned int texels_past_lower_border = tile_lower_right_atlas_texel_y >= (int)atlas_mipmaps[atlas_tile_mipID]->Height() ? (unsigned int)( tile_lower_right_atlas_texel_y - atlas_mipmaps[atlas_tile_mipID]->Height() ) : 0;
-				
-				// Create tile image.
-				ilImage tile_image;
-				tile_image.TexImage(vt_tile_texels_wide, vt_tile_texels_wide, 1, vt_atlas_bpp, vt_atlas_format, vt_atlas_type, NULL);
-				tile_image.Bind();
-				ilClearImage(); // Just to get rid off garbage values. Nice for debugging.
-
-				// Copy corresponding texels from atlas mipmap level.
-				ilBlit(
-					atlas_mipmaps[atlas_tile_mipID]->GetId(),
-					0 + texels_past_left_border,                                               // destination/tile top left x
-					0 + texels_past_upper_border,                                              // destination/tile top left y
-					0,                                                                         // destination/tile top left z
-					tile_top_left_atlas_texel_x + texels_past_left_border,                     // source/atlas top left x
-					tile_top_left_atlas_texel_y + texels_past_upper_border,                    // source/atlas top left y
-					0,                                                                         // source/atlas top left z
-					vt_tile_texels_wide - texels_past_left_border  - texels_past_right_border, // nr texels to copy x
-					vt_tile_texels_wide - texels_past_upper_border - texels_past_lower_border, // nr texels to copy y
-					1                                                                          // nr texels to copy z
-				);
-
-				// Save tile to file.
-				const std::string tile_file_path = tiles_folder_path.string() + "\\tile_mipid_" + std::to_string(atlas_tile_mipID) + "_x_" + std::to_string(tile_x) + "_y_" + std::to_string(tile_y) + vt_atlas_file_format;
-				tile_image.Save(tile_file_path.c_str());
-			}
-		}
-		std::cout << std::endl;
+				if (incremental && dirty_tiles.count({ tile_x, tile_y }) == 0)
+				{
+					continue;
+				}
+				planned_tiles.push_back({ (unsigned int)atlas_tile_mipID, tile_x, tile_y });
+				if (tile_file_writer)
+				{
+					tile_rows_in_flight[{ (unsigned int)atlas_tile_mipID, tile_y }].planned += (unsigned int)layer_count;
+				}
+			}
+		}
+		std::cout << ", " << planned_tiles.size() - planned_before << " tiles to generate." << std::endl;
+	}
+
+	// If the renderer told us what it uses most, that goes first. A run cut short then already has what matters.
+	if (tile_usage.size() > 0)
+	{
+		order_hottest_first(planned_tiles, tile_usage);
+	}
+	std::cout << "Generating " << planned_tiles.size() << " tiles" << (tile_usage.size() > 0 ? ", most used first" : "") << std::endl;
+
+	// Cut the tiles from their atlas mipmap levels and save them.
+	// Tile files are written by threads of their own, whose CPU time is whatever this thread didn't spend meanwhile.
+	const std::chrono::steady_clock::time_point tiles_start = std::chrono::steady_clock::now();
+	const double tiles_start_process_cpu_seconds = process_cpu_seconds();
+	const double tiles_start_thread_cpu_seconds  = thread_cpu_seconds();
+	double submit_cpu_seconds = 0.0;
+	std::vector<planned_tile> missing_tiles;
+	std::vector<uint8_t> interleaved_tile;
+	for (size_t i = 0; i < planned_tiles.size(); i++)
+	{
+		const planned_tile &tile = planned_tiles[i];
+
+		// Out of time? Stop cleanly, keeping track of what is missing.
+		if (vt_time_budget > 0.0f && std::chrono::duration<float>(std::chrono::steady_clock::now() - build_start).count() >= vt_time_budget)
+		{
+			missing_tiles.assign(planned_tiles.begin() + i, planned_tiles.end());
+			break;
+		}
+
+		// Give some output.
+		std::cout << ".";
+
+		// The same tile of every layer, one after the other.
+		interleaved_tile.clear();
+		const std::string tile_detail = trace_enabled() ? "mipID " + std::to_string(tile.mipID) + " x " + std::to_string(tile.x) + " y " + std::to_string(tile.y) : std::string();
+		for (size_t l = 0; l < layer_count; l++)
+		{
+			// Cut tile from atlas mipmap level.
+			ilImage tile_image;
+			{
+				stage_timer timer(pipeline_stats, "tile_cut");
+				timer.detail = tile_detail;
+				timer.bytes_in = timer.bytes_out = tile_bytes;
+				cut_tile(*layer_mipmaps[l][tile.mipID], tile.x, tile.y, vt_tile_texels_wide, vt_tile_border_texels_wide, { vt_atlas_bpp, vt_atlas_format, vt_atlas_type }, tile_image);
+			}
+
+			// Save tile to file or pack. (Packed bytes are counted once the pack is closed.)
+			if (vt_interleave_layers)
+			{
+				interleaved_tile.insert(interleaved_tile.end(), tile_image.GetData(), tile_image.GetData() + tile_bytes);
+				continue;
+			}
+			if (!tile_packs.empty())
+			{
+				stage_timer timer(pipeline_stats, "encode");
+				timer.detail = tile_detail;
+				if (!tile_packs[l]->add_tile((uint32_t)tile.mipID, tile.x, tile.y, tile_image.GetData(), tile_bytes))
+				{
+					std::cout << "Couldn't add tile to tile pack. Exiting..." << std::endl;
+					return 1;
+				}
+				continue;
+			}
+			std::vector<uint8_t> encoded_tile;
+			{
+				stage_timer timer(pipeline_stats, "encode");
+				timer.detail = tile_detail;
+				timer.bytes_in = tile_bytes;
+				if (!encode_image(tile_image, vt_tile_file_format, encoded_tile))
+				{
+					std::cout << "Couldn't encode tile as " << vt_tile_file_format << ". Exiting..." << std::endl;
+					return 1;
+				}
+				timer.bytes_out = encoded_tile.size();
+			}
+			const std::string &tile_file_path = layer_tile_paths[l].path(tile.mipID, tile.x, tile.y);
+			{
+				std::lock_guard<std::mutex> lock(tile_rows_mutex);
+				tile_rows_by_path[tile_file_path] = { tile.mipID, tile.y };
+			}
+			const double submit_start_cpu_seconds = thread_cpu_seconds();
+			tile_file_writer->submit(tile_file_path, std::move(encoded_tile));
+			submit_cpu_seconds += thread_cpu_seconds() - submit_start_cpu_seconds;
+		}
+		if (vt_interleave_layers)
+		{
+			stage_timer timer(pipeline_stats, "encode");
+			timer.detail = tile_detail;
+			if (!tile_packs[0]->add_tile((uint32_t)tile.mipID, tile.x, tile.y, interleaved_tile.data(), interleaved_tile.size()))
+			{
+				std::cout << "Couldn't add tile to tile pack. Exiting..." << std::endl;
+				return 1;
+			}
+		}
+	}
+	std::cout << std::endl;
+	if (!missing_tiles.empty())
+	{
+		std::cout << "Ran out of the time budget of " << vt_time_budget << " seconds with " << missing_tiles.size() << " of " << planned_tiles.size() << " tiles to go." << std::endl;
+	}
+	if (tile_file_writer)
+	{
+		const double flush_start_cpu_seconds = thread_cpu_seconds();
+		tile_file_writer->flush();
+		submit_cpu_seconds += thread_cpu_seconds() - flush_start_cpu_seconds;
+		const tile_writer_stats stats = tile_file_writer->stats();
+		const double other_threads_cpu_seconds = (process_cpu_seconds() - tiles_start_process_cpu_seconds) - (thread_cpu_seconds() - tiles_start_thread_cpu_seconds);
+		pipeline_stats.add("write", std::chrono::duration<double>(std::chrono::steady_clock::now() - tiles_start).count(), other_threads_cpu_seconds + submit_cpu_seconds,
+			stats.files_completed, stats.bytes_completed, stats.bytes_completed);
+		pipeline_stats.set_threads("write", tile_file_writer->backend() == tile_writer_backend::threads ? vt_tile_writer_threads : 1);
+		std::cout << "Wrote " << stats.files_completed << " tile files, " << stats.bytes_completed << " bytes, "
+			<< "at most " << stats.peak_in_flight_bytes << " bytes in flight, "
+			<< stats.seconds_blocked << " seconds waiting on the writer." << std::endl;
+		if (stats.files_failed > 0)
+		{
+			std::cout << "Couldn't write " << stats.files_failed << " tile files. Exiting..." << std::endl;
+			return 1;
+		}
+	}
+	for (size_t l = 0; l < tile_packs.size(); l++)
+	{
+		stage_timer timer(pipeline_stats, "encode", 0);
+		if (!tile_packs[l]->close())
+		{
+			std::cout << "Couldn't finish tile pack. Exiting..." << std::endl;
+			return 1;
+		}
+		timer.bytes_in  = tile_packs[l]->raw_bytes();
+		timer.bytes_out = tile_packs[l]->packed_bytes();
+		std::cout << "Packed " << tile_packs[l]->tiles_written() << " tiles" << (layered && !vt_interleave_layers ? " of layer " + layer_names[l] : "") << " with " << vt_tile_codec_name
+			<< " from " << tile_packs[l]->raw_bytes() << " to " << tile_packs[l]->packed_bytes() << " bytes"
+			<< " using a dictionary of " << tile_packs[l]->dictionary_size() << " bytes." << std::endl;
 	}
 	std::cout << std::endl;
 
@@ -595,7 +1824,8 @@ int main(int argc, char *argv[])
 	// Step 3b: Generate XML with tile info
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	boost::filesystem::path tile_xml_folder_path(output_dir.string() + "\\3b_tiles_xml");
+	xml_timer.reset(new stage_timer(pipeline_stats, "xml"));
+	boost::filesystem::path tile_xml_folder_path(output_dir / "3b_tiles_xml");
 	boost::filesystem::create_directory(tile_xml_folder_path);
 	std::cout << "Creating xml with tile info in " << tile_xml_folder_path.string() << "..." << std::endl;
 
@@ -614,20 +1844,107 @@ int main(int argc, char *argv[])
 	xml_tile_info.attribute("dimensions_in_texels").set_value(vt_tile_texels_wide);
 	xml_tile_info.attribute("border_in_texels").set_value(vt_tile_border_texels_wide);
 	xml_tile_info.attribute("file_extension").set_value(vt_tile_file_format.c_str());
+	xml_tile_info.append_attribute("container").set_value(vt_tile_container.c_str());
+	if (tile_packs.empty())
+	{
+		xml_tile_info.append_attribute("layout").set_value(tile_layout_to_string(layer_tile_paths[0].layout()).c_str());
+		xml_tile_info.append_attribute("shard_fan_out").set_value(layer_tile_paths[0].fan_out());
+		xml_tile_info.append_attribute("path_pattern").set_value(layer_tile_paths[0].pattern().c_str());
+	}
+	else
+	{
+		xml_tile_info.append_attribute("pack_file").set_value((vt_interleave_layers ? "tiles.vtpack" : layer_file_name("tiles", ".vtpack", 0)).c_str());
+		xml_tile_info.append_attribute("codec").set_value(tile_codec_to_string(vt_tile_codec).c_str());
+		xml_tile_info.append_attribute("bytes_per_texel").set_value(vt_atlas_bpp);
+		if (vt_interleave_layers)
+		{
+			xml_tile_info.append_attribute("interleaved_layers").set_value(true);
+		}
+	}
+	// Each layer has its own folder of tile files, or its own tile pack, with the same tiles in it.
+	for (size_t l = 0; l < layer_count && layered; l++)
+	{
+		pugi::xml_node xml_layer = xml_tile_info.append_child("layer");
+		xml_layer.append_attribute("name").set_value(layer_names[l].c_str());
+		if (tile_packs.empty())
+		{
+			xml_layer.append_attribute("folder").set_value(layer_names[l].c_str());
+		}
+		else if (vt_interleave_layers)
+		{
+			xml_layer.append_attribute("offset").set_value((unsigned long long)(l * tile_bytes)); // Bytes into a decoded record.
+		}
+		else
+		{
+			xml_layer.append_attribute("pack_file").set_value(layer_file_name("tiles", ".vtpack", l).c_str());
+		}
+	}
+	// Tiles a time budgeted run didn't get to. A renderer has to fall back on coarser tiles for these.
+	if (!missing_tiles.empty())
+	{
+		pugi::xml_node xml_missing_tiles = xml_tile_info.append_child("missing_tiles");
+		xml_missing_tiles.append_attribute("count").set_value((unsigned int)missing_tiles.size());
+		for (const planned_tile &tile : missing_tiles)
+		{
+			pugi::xml_node xml_missing_tile = xml_missing_tiles.append_child("tile");
+			xml_missing_tile.append_attribute("mipID").set_value(tile.mipID);
+			xml_missing_tile.append_attribute("x").set_value(tile.x);
+			xml_missing_tile.append_attribute("y").set_value(tile.y);
+		}
+	}
 
 	// Save file.
-	const std::string tile_xml_file_path = tile_xml_folder_path.string() + "\\tile_info.xml";
+	const std::string tile_xml_file_path = (tile_xml_folder_path / "tile_info.xml").string();
 	std::cout << "Saving xml document " << tile_xml_file_path << "." << std::endl;
 	tile_xml_document.save_file(tile_xml_file_path.c_str(), PUGIXML_TEXT("    "), pugi::format_default, pugi::encoding_utf8);
+	xml_timer.reset();
     std::cout << std::endl;
 
+	// An unfinished build is for --resume to finish. A manifest would have the next incremental build take it as complete.
+	if (!missing_tiles.empty())
+	{
+		boost::system::error_code ignored;
+		boost::filesystem::remove(build_manifest_file_path, ignored);
+		for (std::vector<ilImage*> &mipmaps : layer_mipmaps)
+		{
+			for (ilImage* mipmap_level : mipmaps)
+			{
+				delete mipmap_level;
+			}
+		}
+		save_build_stats();
+		std::cout << "Run again with --resume to generate the missing tiles.\nBye bye." << std::endl;
+		return 0;
+	}
+
+	// Record what this build was made from, so the next one can build upon it.
+	build_manifest current_build;
+	current_build.parameters = build_parameters;
+	for (subtexture &subtexture : subtextures)
+	{
+		current_build.subtextures.push_back(subtexture.to_manifest());
+	}
+	std::cout << "Saving build manifest " << build_manifest_file_path << "." << std::endl;
+	if (!current_build.save(build_manifest_file_path))
+	{
+		std::cout << "Couldn't save build manifest. The next build can't be incremental." << std::endl;
+	}
+	std::cout << std::endl;
+
+	// The build is complete, nothing left to resume.
+	journal.remove();
+	save_build_stats();
+
 
     /////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// Closing
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////
-	for (ilImage* mipmap_level : atlas_mipmaps)
+	for (std::vector<ilImage*> &mipmaps : layer_mipmaps)
 	{
-		delete mipmap_level;
+		for (ilImage* mipmap_level : mipmaps)
+		{
+			delete mipmap_level;
+		}
 	}
 	std::cout << "Done!\nBye bye." << std::endl;
 
@@ -0,0 +1,508 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// vtTraceReplay replays a recorded trace of tile requests against the tiles written by vtTileCreator, loose files or
+// a tile pack, or against a running tile server (vtTileCreator --serve), and reports how fast the tiles came back.
+// Trace lines read "<timestamp in seconds> <mipID> <x> <y>". Empty lines and lines starting with # are skipped.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <thread>
+#include <boost/asio.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "pugixml/pugixml.hpp"
+#include "tile_cache.h"
+#include "tile_pack.h"
+#include "tile_path.h"
+
+namespace po = boost::program_options;
+
+struct trace_request
+{
+	double       timestamp;
+	unsigned int mipID;
+	unsigned int x;
+	unsigned int y;
+};
+
+// Where tiles are fetched from. Every replay thread gets its own.
+class tile_source
+{
+public:
+	virtual ~tile_source() {}
+	virtual bool fetch(const unsigned int &mipID, const unsigned int &x, const unsigned int &y, std::vector<uint8_t> &tile) = 0;
+};
+
+class file_tile_source : public tile_source
+{
+public:
+	file_tile_source(const std::string &tiles_folder, const tile_layout &layout, const unsigned int &fan_out, const std::string &file_extension) :
+		m_paths(tiles_folder, layout, fan_out, file_extension)
+	{}
+
+	bool fetch(const unsigned int &mipID, const unsigned int &x, const unsigned int &y, std::vector<uint8_t> &tile) override
+	{
+		std::ifstream file(m_paths.path(mipID, x, y), std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			return false;
+		}
+		tile.resize((size_t)file.tellg());
+		file.seekg(0);
+		return (bool)file.read(reinterpret_cast<char*>(tile.data()), tile.size());
+	}
+
+private:
+	tile_path_builder m_paths;
+};
+
+class pack_tile_source : public tile_source
+{
+public:
+	bool open(const std::string &pack_file_path) { return m_pack.open(pack_file_path); }
+
+	bool fetch(const unsigned int &mipID, const unsigned int &x, const unsigned int &y, std::vector<uint8_t> &tile) override
+	{
+		return m_pack.read_tile(mipID, x, y, tile);
+	}
+
+private:
+	tile_pack_reader m_pack;
+};
+
+// Talks HTTP/1.1 to a tile server over one kept alive connection, TCP or Unix domain socket.
+template <typename Protocol>
+class server_tile_source : public tile_source
+{
+public:
+	explicit server_tile_source(const typename Protocol::endpoint &endpoint) :
+		m_socket(m_io_context),
+		m_endpoint(endpoint)
+	{}
+
+	bool fetch(const unsigned int &mipID, const unsigned int &x, const unsigned int &y, std::vector<uint8_t> &tile) override
+	{
+		return get("/tiles/" + std::to_string(mipID) + "/" + std::to_string(x) + "/" + std::to_string(y), tile) == 200;
+	}
+
+	// Returns the HTTP status, or 0 if the server couldn't be reached.
+	unsigned int get(const std::string &target, std::vector<uint8_t> &body)
+	{
+		// The server may have closed the kept alive connection meanwhile. Then it's worth one more try.
+		for (int attempt = 0; attempt < 2; attempt++)
+		{
+			boost::system::error_code error;
+			if (!m_socket.is_open())
+			{
+				m_buffer.consume(m_buffer.size());
+				m_socket.connect(m_endpoint, error);
+				if (error)
+				{
+					m_socket.close(error);
+					return 0;
+				}
+			}
+			const unsigned int status = request(target, body);
+			if (status != 0)
+			{
+				return status;
+			}
+			m_socket.close(error);
+		}
+		return 0;
+	}
+
+private:
+	unsigned int request(const std::string &target, std::vector<uint8_t> &body)
+	{
+		boost::system::error_code error;
+		const std::string request = "GET " + target + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+		boost::asio::write(m_socket, boost::asio::buffer(request), error);
+		if (!error) boost::asio::read_until(m_socket, m_buffer, "\r\n\r\n", error);
+		if (error)
+		{
+			return 0;
+		}
+
+		std::istream response(&m_buffer);
+		std::string version, line;
+		unsigned int status = 0;
+		size_t content_length = 0;
+		bool closing = false;
+		response >> version >> status;
+		std::getline(response, line);
+		while (std::getline(response, line) && line != "\r")
+		{
+			std::transform(line.begin(), line.end(), line.begin(), ::tolower);
+			if (line.compare(0, 15, "content-length:") == 0)
+			{
+				content_length = (size_t)std::strtoull(line.c_str() + 15, nullptr, 10);
+			}
+			else if (line.compare(0, 11, "connection:") == 0)
+			{
+				closing = line.find("close") != std::string::npos;
+			}
+		}
+
+		// Part of the body may have come in along with the header.
+		body.resize(content_length);
+		const size_t buffered = std::min(content_length, m_buffer.size());
+		m_buffer.sgetn(reinterpret_cast<char*>(body.data()), buffered);
+		if (content_length > buffered)
+		{
+			boost::asio::read(m_socket, boost::asio::buffer(body.data() + buffered, content_length - buffered), error);
+			if (error)
+			{
+				return 0;
+			}
+		}
+		if (closing)
+		{
+			m_socket.close(error);
+		}
+		return status;
+	}
+
+	boost::asio::io_context     m_io_context;
+	typename Protocol::socket   m_socket;
+	typename Protocol::endpoint m_endpoint;
+	boost::asio::streambuf      m_buffer;
+};
+
+// Reads a number from the tile server's /stats JSON.
+uint64_t json_counter(const std::string &json, const std::string &name)
+{
+	const size_t found = json.find("\"" + name + "\":");
+	return found == std::string::npos ? 0 : std::strtoull(json.c_str() + found + name.size() + 3, nullptr, 10);
+}
+
+// Nearest rank percentile of sorted values.
+double percentile(const std::vector<double> &sorted, const double &fraction)
+{
+	if (sorted.empty())
+	{
+		return 0.0;
+	}
+	const size_t rank = (size_t)std::ceil(fraction * sorted.size());
+	return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+int main(int argc, char *argv[])
+{
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Parse command line options.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	std::string  trace_path;
+	std::string  tiles_path;
+	std::string  server_endpoint;
+	std::string  layer_name;
+	unsigned int concurrency;
+	bool         timed;
+	double       speed;
+	unsigned int cache_size_mib;
+
+	po::options_description options("Allowed options");
+	options.add_options()
+		("help", "produce help message")
+		("trace,t", po::value< std::string >(&trace_path), "trace of tile requests to replay")
+		("tiles", po::value< std::string >(&tiles_path)->default_value(""), "output path of a vtTileCreator run to fetch tiles from, loose files or tile pack")
+		("layer", po::value< std::string >(&layer_name)->default_value(""), "material layer to fetch tiles of, for runs with --layers")
+		("server", po::value< std::string >(&server_endpoint)->default_value(""), "tile server to fetch tiles from: [address:]port or unix:socket_path")
+		("concurrency,c", po::value<unsigned int>(&concurrency)->default_value(1), "number of requests in flight at once")
+		("timed", po::bool_switch(&timed), "issue requests at their trace timestamps instead of as fast as possible")
+		("speed", po::value<double>(&speed)->default_value(1.0), "how many times faster than recorded to replay a timed trace")
+		("cache-size", po::value<unsigned int>(&cache_size_mib)->default_value(0), "MiB of tiles to keep in a least recently used cache in front of the source, 0 for none")
+		;
+	po::positional_options_description positionals;
+	positionals.add("trace", 1);
+
+	po::variables_map variables;
+	po::store(po::command_line_parser(argc, argv).options(options).positional(positionals).run(), variables);
+	po::notify(variables);
+
+	if (variables.count("help") || trace_path.empty())
+	{
+		std::cout << "vtTraceReplay replays a trace of tile requests and reports latency, throughput and cache hit rates.\n"
+			<< options << std::endl;
+		return 1;
+	}
+	if (tiles_path.empty() == server_endpoint.empty())
+	{
+		std::cout << "Give either --tiles or --server to fetch tiles from. Exiting..." << std::endl;
+		return 1;
+	}
+	concurrency = std::max(concurrency, 1u);
+
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Load the trace.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	std::vector<trace_request> trace;
+	std::ifstream trace_file(trace_path);
+	if (!trace_file)
+	{
+		std::cout << "Couldn't open trace " << trace_path << ". Exiting..." << std::endl;
+		return 1;
+	}
+	std::string line;
+	for (size_t line_number = 1; std::getline(trace_file, line); line_number++)
+	{
+		if (line.empty() || line[0] == '#' || line.find_first_not_of(" \t\r") == std::string::npos)
+		{
+			continue;
+		}
+		std::istringstream fields(line);
+		trace_request request;
+		if (!(fields >> request.timestamp >> request.mipID >> request.x >> request.y))
+		{
+			std::cout << "Couldn't read line " << line_number << " of trace " << trace_path << ". Exiting..." << std::endl;
+			return 1;
+		}
+		trace.push_back(request);
+	}
+	if (trace.empty())
+	{
+		std::cout << "Trace " << trace_path << " holds no requests. Exiting..." << std::endl;
+		return 1;
+	}
+	std::stable_sort(trace.begin(), trace.end(), [](const trace_request &a, const trace_request &b) { return a.timestamp < b.timestamp; });
+	std::cout << "Loaded " << trace.size() << " requests spanning " << trace.back().timestamp - trace.front().timestamp << " seconds." << std::endl;
+
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Prepare a tile source per thread.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	std::vector<std::unique_ptr<tile_source>> sources;
+	std::function<std::string()> server_stats; // Only for tile servers.
+	if (!tiles_path.empty())
+	{
+		// What was written, and how, is in the tile info of the run.
+		const boost::filesystem::path output_dir(tiles_path);
+		const std::string tile_info_path = (output_dir / "3b_tiles_xml" / "tile_info.xml").string();
+		pugi::xml_document tile_info_document;
+		const pugi::xml_node tile_info = tile_info_document.load_file(tile_info_path.c_str()) ? tile_info_document.child("tile_info") : pugi::xml_node();
+		if (!tile_info)
+		{
+			std::cout << "Couldn't read tile info " << tile_info_path << ". Exiting..." << std::endl;
+			return 1;
+		}
+
+		boost::filesystem::path tiles_folder = output_dir / "3a_tiles";
+		const std::string container = tile_info.attribute("container").as_string("files");
+		std::string pack_file = tile_info.attribute("pack_file").as_string();
+
+		// A run with material layers has a folder or tile pack per layer, unless all layers share one interleaved pack.
+		if (tile_info.child("layer"))
+		{
+			std::string layer_names;
+			pugi::xml_node xml_layer;
+			for (pugi::xml_node xml_candidate = tile_info.child("layer"); xml_candidate; xml_candidate = xml_candidate.next_sibling("layer"))
+			{
+				layer_names += (layer_names.empty() ? "" : ",") + std::string(xml_candidate.attribute("name").value());
+				if (layer_name == xml_candidate.attribute("name").value())
+				{
+					xml_layer = xml_candidate;
+				}
+			}
+			if (!xml_layer)
+			{
+				std::cout << "The run in " << tiles_path << " has layers " << layer_names << ". Pick one with --layer. Exiting..." << std::endl;
+				return 1;
+			}
+			if (container == "pack" && !tile_info.attribute("interleaved_layers").as_bool())
+			{
+				pack_file = xml_layer.attribute("pack_file").as_string();
+			}
+			else if (container != "pack")
+			{
+				tiles_folder /= xml_layer.attribute("folder").as_string();
+			}
+			// Interleaved packs hold every layer in each record, so a fetch gets them all anyway.
+		}
+		else if (!layer_name.empty())
+		{
+			std::cout << "The run in " << tiles_path << " has no layers, so there's no layer " << layer_name << ". Exiting..." << std::endl;
+			return 1;
+		}
+
+		for (unsigned int i = 0; i < concurrency; i++)
+		{
+			if (container == "pack")
+			{
+				std::unique_ptr<pack_tile_source> pack(new pack_tile_source());
+				const std::string pack_file_path = (tiles_folder / pack_file).string();
+				if (!pack->open(pack_file_path))
+				{
+					std::cout << "Couldn't open tile pack " << pack_file_path << ". Exiting..." << std::endl;
+					return 1;
+				}
+				sources.push_back(std::move(pack));
+				continue;
+			}
+			tile_layout layout = tile_layout::flat;
+			tile_layout_from_string(tile_info.attribute("layout").as_string("flat"), layout);
+			sources.emplace_back(new file_tile_source(tiles_folder.string(), layout, tile_info.attribute("shard_fan_out").as_uint(16), tile_info.attribute("file_extension").as_string()));
+		}
+		std::cout << "Fetching tiles from " << (container == "pack" ? "tile pack " + pack_file : "tile files") << " in " << tiles_folder.string() << "." << std::endl;
+	}
+	else
+	{
+		auto add_server_sources = [&](auto endpoint) {
+			typedef typename decltype(endpoint)::protocol_type protocol;
+			for (unsigned int i = 0; i < concurrency; i++)
+			{
+				sources.emplace_back(new server_tile_source<protocol>(endpoint));
+			}
+			std::shared_ptr<server_tile_source<protocol>> stats_source = std::make_shared<server_tile_source<protocol>>(endpoint);
+			server_stats = [stats_source]() {
+				std::vector<uint8_t> json;
+				return stats_source->get("/stats", json) == 200 ? std::string(json.begin(), json.end()) : std::string();
+			};
+		};
+
+		if (server_endpoint.compare(0, 5, "unix:") == 0)
+		{
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+			add_server_sources(boost::asio::local::stream_protocol::endpoint(server_endpoint.substr(5)));
+#else
+			std::cout << "Unix domain sockets aren't supported on this platform. Exiting..." << std::endl;
+			return 1;
+#endif
+		}
+		else
+		{
+			const size_t colon = server_endpoint.rfind(':');
+			const std::string address = colon == std::string::npos ? "127.0.0.1" : server_endpoint.substr(0, colon);
+			const std::string port    = colon == std::string::npos ? server_endpoint : server_endpoint.substr(colon + 1);
+			boost::system::error_code error;
+			const boost::asio::ip::address ip = boost::asio::ip::make_address(address, error);
+			if (error || port.empty() || port.find_first_not_of("0123456789") != std::string::npos || std::stoul(port) > 65535)
+			{
+				std::cout << "Invalid tile server " << server_endpoint << ". Exiting..." << std::endl;
+				return 1;
+			}
+			add_server_sources(boost::asio::ip::tcp::endpoint(ip, (unsigned short)std::stoul(port)));
+		}
+		if (server_stats().empty())
+		{
+			std::cout << "Couldn't reach tile server " << server_endpoint << ". Exiting..." << std::endl;
+			return 1;
+		}
+		std::cout << "Fetching tiles from tile server " << server_endpoint << "." << std::endl;
+	}
+	const std::string server_stats_before = server_stats ? server_stats() : std::string();
+
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Replay.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	typedef std::chrono::steady_clock clock;
+	std::unique_ptr<tile_cache> cache(cache_size_mib > 0 ? new tile_cache((size_t)cache_size_mib << 20) : nullptr);
+	std::atomic<size_t>   next_request(0);
+	std::atomic<uint64_t> failed_requests(0);
+	std::atomic<uint64_t> bytes_fetched(0);
+	std::vector<std::vector<double>> latencies_per_thread(concurrency);
+	std::cout << "Replaying " << (timed ? "at trace timestamps" : "as fast as possible") << " with " << concurrency << " requests in flight..." << std::endl;
+
+	const clock::time_point start = clock::now();
+	std::vector<std::thread> threads;
+	for (unsigned int thread_index = 0; thread_index < concurrency; thread_index++)
+	{
+		threads.emplace_back([&, thread_index]() {
+			tile_source &source = *sources[thread_index];
+			std::vector<double> &latencies = latencies_per_thread[thread_index];
+			std::vector<uint8_t> tile;
+			for (size_t i = next_request++; i < trace.size(); i = next_request++)
+			{
+				const trace_request &request = trace[i];
+
+				// A timed request counts from when it should have gone out, so falling behind the trace shows in latency.
+				clock::time_point issued = clock::now();
+				if (timed)
+				{
+					issued = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>((request.timestamp - trace.front().timestamp) / speed));
+					std::this_thread::sleep_until(issued);
+				}
+
+				const uint64_t key = tile_pack_key(request.mipID, request.x, request.y);
+				shared_tile cached = cache ? cache->find(key) : shared_tile();
+				size_t tile_bytes = cached ? cached->size() : 0;
+				if (!cached)
+				{
+					if (!source.fetch(request.mipID, request.x, request.y, tile))
+					{
+						failed_requests++;
+						continue;
+					}
+					tile_bytes = tile.size();
+					if (cache)
+					{
+						cache->insert(key, std::make_shared<const std::vector<uint8_t>>(tile));
+					}
+				}
+				bytes_fetched += tile_bytes;
+				latencies.push_back(std::chrono::duration<double, std::milli>(clock::now() - issued).count());
+			}
+		});
+	}
+	for (std::thread &thread : threads)
+	{
+		thread.join();
+	}
+	const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Report.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	std::vector<double> latencies;
+	for (const std::vector<double> &thread_latencies : latencies_per_thread)
+	{
+		latencies.insert(latencies.end(), thread_latencies.begin(), thread_latencies.end());
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	std::cout << std::endl
+		<< "Requests:   " << trace.size() << ", of which " << failed_requests << " failed." << std::endl
+		<< "Duration:   " << seconds << " s." << std::endl
+		<< "Throughput: " << latencies.size() / seconds << " tiles/s, " << bytes_fetched / seconds / (1 << 20) << " MiB/s." << std::endl
+		<< "Latency:    p50 " << percentile(latencies, 0.50) << " ms, p95 " << percentile(latencies, 0.95) << " ms, p99 " << percentile(latencies, 0.99) << " ms, max " << (latencies.empty() ? 0.0 : latencies.back()) << " ms." << std::endl;
+	if (cache)
+	{
+		const uint64_t lookups = cache->hits() + cache->misses();
+		std::cout << "Replay cache: " << cache->hits() << " hits, " << cache->misses() << " misses, "
+			<< (lookups ? 100.0 * cache->hits() / lookups : 0.0) << "% hit rate." << std::endl;
+	}
+	if (server_stats)
+	{
+		const std::string server_stats_after = server_stats();
+		const uint64_t hits    = json_counter(server_stats_after, "cache_hits")   - json_counter(server_stats_before, "cache_hits");
+		const uint64_t misses  = json_counter(server_stats_after, "cache_misses") - json_counter(server_stats_before, "cache_misses");
+		const uint64_t lookups = hits + misses;
+		std::cout << "Server cache: " << hits << " hits, " << misses << " misses, "
+			<< (lookups ? 100.0 * hits / lookups : 0.0) << "% hit rate, "
+			<< json_counter(server_stats_after, "tiles_generated") - json_counter(server_stats_before, "tiles_generated") << " tiles generated." << std::endl;
+	}
+
+	return failed_requests > 0 ? 1 : 0;
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright 2017 Hans Cronau
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// vtWorkloadGenerator writes any number of procedural subtextures and the input list to feed them to vtTileCreator
+// with (--input-list). The same seed and options always give the same files, so large runs can be reproduced
+// anywhere without shipping the textures.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "DevIL/devil_cpp_wrapper.h"
+
+#include "helper_functions.h"
+
+namespace po = boost::program_options;
+
+struct generated_subtexture
+{
+	std::string  file_name;
+	unsigned int texels_wide;
+	unsigned int texels_high;
+	int          duplicate_of; // Index of the subtexture this is a copy of, or -1.
+};
+
+// The standard distributions differ between standard libraries, mt19937 itself doesn't. So draws are made here.
+static double draw_unit(std::mt19937 &random)
+{
+	return random() / 4294967296.0; // [0, 1)
+}
+
+static unsigned int draw_between(std::mt19937 &random, const unsigned int &min, const unsigned int &max)
+{
+	return min + (unsigned int)(((uint64_t)random() * ((uint64_t)max - min + 1)) >> 32); // [min, max]
+}
+
+// Picks the longer side of a subtexture.
+static unsigned int pick_size(const std::string &distribution, const unsigned int &min_size, const unsigned int &max_size, std::mt19937 &random)
+{
+	if (distribution == "uniform")
+	{
+		return draw_between(random, min_size, max_size);
+	}
+	// Like real assets: small textures are much more common than large ones.
+	const double log_size = std::log2((double)min_size) + draw_unit(random) * (std::log2((double)max_size) - std::log2((double)min_size));
+	if (distribution == "pow2")
+	{
+		return std::max(min_size, std::min(max_size, 1u << (unsigned int)std::lround(log_size)));
+	}
+	return std::max(min_size, std::min(max_size, (unsigned int)std::lround(std::exp2(log_size))));
+}
+
+// A few soft colour gradients mixed with noise. Entropy 0 is smooth and compresses well, entropy 1 is pure noise.
+static void fill_texels(ILubyte *texels, const unsigned int &texels_wide, const unsigned int &texels_high, const unsigned int &channels, const double &entropy, std::mt19937 &random)
+{
+	std::vector<double> base(channels), slope_x(channels), slope_y(channels), wave(channels);
+	for (unsigned int c = 0; c < channels; c++)
+	{
+		base[c]    = draw_unit(random) * 255.0;
+		slope_x[c] = (draw_unit(random) - 0.5) * 255.0 / texels_wide;
+		slope_y[c] = (draw_unit(random) - 0.5) * 255.0 / texels_high;
+		wave[c]    = 1.0 + draw_unit(random) * 7.0;
+	}
+	const double pi = 3.14159265358979323846;
+	for (unsigned int y = 0; y < texels_high; y++)
+	{
+		for (unsigned int x = 0; x < texels_wide; x++)
+		{
+			for (unsigned int c = 0; c < channels; c++)
+			{
+				double smooth = base[c] + slope_x[c] * x + slope_y[c] * y + 32.0 * std::sin(2.0 * pi * wave[c] * (x + y) / (texels_wide + texels_high));
+				smooth = std::min(255.0, std::max(0.0, smooth));
+				const double value = (1.0 - entropy) * smooth + entropy * draw_between(random, 0, 255);
+				texels[((size_t)y * texels_wide + x) * channels + c] = (ILubyte)std::lround(value);
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Parse command line options.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	std::string  output_path;
+	unsigned int count;
+	unsigned int seed;
+	std::string  size_distribution;
+	unsigned int min_size;
+	unsigned int max_size;
+	std::string  aspect_ratios_text;
+	double       duplicate_fraction;
+	double       entropy;
+	unsigned int channels;
+	std::string  file_format;
+
+	po::options_description options("Allowed options");
+	options.add_options()
+		("help", "produce help message")
+		("output-path,o", po::value< std::string >(&output_path), "directory to write subtextures and the input list to")
+		("count,n", po::value<unsigned int>(&count)->default_value(1000), "number of subtextures to generate")
+		("seed", po::value<unsigned int>(&seed)->default_value(1), "seed of everything random, the same seed and options give the same files")
+		("size-distribution", po::value< std::string >(&size_distribution)->default_value("pow2"), "how the longer side is picked: uniform, log (log-uniform) or pow2 (log-uniform powers of two)")
+		("min-size", po::value<unsigned int>(&min_size)->default_value(64), "smallest side in texels")
+		("max-size", po::value<unsigned int>(&max_size)->default_value(1024), "largest longer side in texels")
+		("aspect-ratios", po::value< std::string >(&aspect_ratios_text)->default_value("1,1,2,4"), "comma separated long to short side ratios to pick from, repeat one to make it more likely")
+		("duplicate-fraction", po::value<double>(&duplicate_fraction)->default_value(0.0), "fraction (0 to 1) of subtextures that are byte for byte copies of an earlier one")
+		("entropy", po::value<double>(&entropy)->default_value(0.5), "content entropy from 0 (smooth gradients) to 1 (noise)")
+		("channels", po::value<unsigned int>(&channels)->default_value(3), "channels per texel: 1 (grey), 2 (grey and alpha), 3 (RGB) or 4 (RGBA)")
+		("format", po::value< std::string >(&file_format)->default_value(".png"), "extension to use for subtexture image files")
+		;
+
+	po::variables_map variables;
+	po::store(po::parse_command_line(argc, argv, options), variables);
+	po::notify(variables);
+
+	if (variables.count("help") || output_path.empty())
+	{
+		std::cout << "vtWorkloadGenerator writes procedural subtextures and an input list for vtTileCreator.\n"
+			<< options << std::endl;
+		return 1;
+	}
+	if (size_distribution != "uniform" && size_distribution != "log" && size_distribution != "pow2")
+	{
+		std::cout << "Unknown size distribution " << size_distribution << ". Use uniform, log or pow2. Exiting..." << std::endl;
+		return 1;
+	}
+	if (min_size < 1 || min_size > max_size)
+	{
+		std::cout << "Minimum size must be at least 1 and at most the maximum size. Exiting..." << std::endl;
+		return 1;
+	}
+	std::vector<double> aspect_ratios;
+	std::vector<std::string> aspect_ratio_texts;
+	boost::split(aspect_ratio_texts, aspect_ratios_text, boost::is_any_of(","));
+	for (const std::string &aspect_ratio_text : aspect_ratio_texts)
+	{
+		const double aspect_ratio = std::atof(aspect_ratio_text.c_str());
+		if (aspect_ratio < 1.0)
+		{
+			std::cout << "Aspect ratio " << aspect_ratio_text << " should be a number of at least 1. Exiting..." << std::endl;
+			return 1;
+		}
+		aspect_ratios.push_back(aspect_ratio);
+	}
+	if (duplicate_fraction < 0.0 || duplicate_fraction > 1.0 || entropy < 0.0 || entropy > 1.0)
+	{
+		std::cout << "Duplicate fraction and entropy should be between 0 and 1. Exiting..." << std::endl;
+		return 1;
+	}
+	if (channels < 1 || channels > 4)
+	{
+		std::cout << "Only 1 to 4 channels are supported. Exiting..." << std::endl;
+		return 1;
+	}
+
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Plan all subtextures before writing any, so the plan only depends on the seed and options.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	std::mt19937 random(seed);
+	const int nr_characters_for_index = (int)std::to_string(std::max(count, 1u) - 1).size();
+
+	std::vector<generated_subtexture> plan;
+	std::vector<unsigned int> content_seeds;
+	std::vector<size_t> originals; // Indices of the subtextures that aren't duplicates.
+	uint64_t total_texels = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		generated_subtexture subtexture;
+		subtexture.file_name = "subtexture_" + lead_zeroes((int)i, nr_characters_for_index) + file_format;
+		subtexture.duplicate_of = -1;
+
+		const double duplicate_draw = draw_unit(random);
+		if (!originals.empty() && duplicate_draw < duplicate_fraction)
+		{
+			const size_t original = originals[draw_between(random, 0, (unsigned int)originals.size() - 1)];
+			subtexture.duplicate_of = (int)original;
+			subtexture.texels_wide  = plan[original].texels_wide;
+			subtexture.texels_high  = plan[original].texels_high;
+		}
+		else
+		{
+			const unsigned int longer_side  = pick_size(size_distribution, min_size, max_size, random);
+			const unsigned int shorter_side = std::max(min_size, (unsigned int)std::lround(longer_side / aspect_ratios[draw_between(random, 0, (unsigned int)aspect_ratios.size() - 1)]));
+			const bool         landscape    = draw_unit(random) < 0.5;
+			subtexture.texels_wide = landscape ? longer_side  : shorter_side;
+			subtexture.texels_high = landscape ? shorter_side : longer_side;
+			originals.push_back(i);
+		}
+		content_seeds.push_back((unsigned int)random());
+		total_texels += (uint64_t)subtexture.texels_wide * subtexture.texels_high;
+		plan.push_back(subtexture);
+	}
+
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Write subtextures and the input list.
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	const boost::filesystem::path output_dir(output_path);
+	boost::system::error_code error;
+	boost::filesystem::create_directories(output_dir, error);
+	if (!boost::filesystem::is_directory(output_dir))
+	{
+		std::cout << "Couldn't create output directory " << output_dir << ". Exiting..." << std::endl;
+		return 1;
+	}
+
+	std::cout << "Writing " << count << " subtextures to " << output_dir.string() << "..." << std::endl;
+	ilState::Enable(IL_FILE_OVERWRITE);
+	ilState::Enable(IL_ORIGIN_SET);
+	ilState::Origin(IL_ORIGIN_UPPER_LEFT);
+	const ILenum channel_formats[4] = { IL_LUMINANCE, IL_LUMINANCE_ALPHA, IL_RGB, IL_RGBA };
+	for (size_t i = 0; i < plan.size(); i++)
+	{
+		const generated_subtexture &subtexture = plan[i];
+		const std::string file_path = (output_dir / subtexture.file_name).string();
+		if (subtexture.duplicate_of >= 0)
+		{
+			boost::filesystem::remove(file_path, error);
+			boost::filesystem::copy_file(output_dir / plan[subtexture.duplicate_of].file_name, file_path, error);
+			if (error)
+			{
+				std::cout << "Couldn't copy to " << file_path << ": " << error.message() << ". Exiting..." << std::endl;
+				return 1;
+			}
+			continue;
+		}
+
+		std::mt19937 content_random(content_seeds[i]);
+		ilImage image;
+		image.TexImage(subtexture.texels_wide, subtexture.texels_high, 1, (ILubyte)channels, channel_formats[channels - 1], IL_UNSIGNED_BYTE, NULL);
+		fill_texels(image.GetData(), subtexture.texels_wide, subtexture.texels_high, channels, entropy, content_random);
+		if (!image.Save(file_path.c_str()))
+		{
+			std::cout << "Couldn't save " << file_path << ". Exiting..." << std::endl;
+			return 1;
+		}
+		if ((i + 1) % 1000 == 0)
+		{
+			std::cout << " - " << i + 1 << " of " << count << " written." << std::endl;
+		}
+	}
+
+	// The list names files relative to itself, which is how vtTileCreator reads it. The comments say how to redo it.
+	const std::string input_list_path = (output_dir / "input_list.txt").string();
+	std::ofstream input_list(input_list_path);
+	input_list << "# vtWorkloadGenerator --count " << count << " --seed " << seed
+		<< " --size-distribution " << size_distribution << " --min-size " << min_size << " --max-size " << max_size
+		<< " --aspect-ratios " << aspect_ratios_text << " --duplicate-fraction " << duplicate_fraction
+		<< " --entropy " << entropy << " --channels " << channels << " --format " << file_format << "\n"
+		<< "# " << originals.size() << " unique subtextures, " << total_texels << " texels in total.\n";
+	for (const generated_subtexture &subtexture : plan)
+	{
+		input_list << subtexture.file_name << "\n";
+	}
+	input_list.close();
+	if (!input_list)
+	{
+		std::cout << "Couldn't write input list " << input_list_path << ". Exiting..." << std::endl;
+		return 1;
+	}
+
+	// Packing never fills an atlas completely, so leave a quarter to spare.
+	unsigned int atlas_texels_wide = 1;
+	while ((uint64_t)atlas_texels_wide * atlas_texels_wide * 3 < total_texels * 4)
+	{
+		atlas_texels_wide *= 2;
+	}
+	std::cout << "Wrote " << count << " subtextures (" << originals.size() << " unique, " << total_texels << " texels) and input list " << input_list_path << "." << std::endl
+		<< "Build them with: vtTileCreator --input-list " << input_list_path << " --atlas-width " << atlas_texels_wide << std::endl;
+	return 0;
+}